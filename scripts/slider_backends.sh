@@ -0,0 +1,38 @@
+#!/bin/sh
+
+#
+# Compares sliding attacks backends: runs 'attackbench' and a fixed depth bench
+# on engines built with different 'sliders' settings, and reports the attack
+# lookups per second and the end-to-end nps of each.
+#
+# Usage: slider_backends.sh [depth] engine...
+#
+# For example:
+#   for b in magic hq kogge; do
+#     make -j clean build ARCH=x86-64-avx2 sliders=$b && cp stockfish stockfish-$b
+#   done
+#   slider_backends.sh 13 ./stockfish-magic ./stockfish-hq ./stockfish-kogge
+#
+
+depth=${1:-13}
+[ $# -gt 1 ] && shift || set -- ./stockfish
+
+printf '%-8s %14s %14s %14s %10s\n' backend "rook/s" "bishop/s" "queen/s" nps
+
+for engine; do
+  out=$(
+    {
+      echo "attackbench"
+      echo "bench 16 1 $depth default depth"
+      echo "quit"
+    } | "$engine" 2>&1
+  )
+
+  backend=$(printf '%s\n' "$out" | awk '/^Sliding attacks/ {print $NF}')
+  rook=$(printf '%s\n' "$out" | awk '/^Rook attacks/ {print $NF}')
+  bishop=$(printf '%s\n' "$out" | awk '/^Bishop attacks/ {print $NF}')
+  queen=$(printf '%s\n' "$out" | awk '/^Queen attacks/ {print $NF}')
+  nps=$(printf '%s\n' "$out" | awk '/^Nodes\/second/ {print $NF}')
+
+  printf '%-8s %14d %14d %14d %10d\n' "$backend" "$rook" "$bishop" "$queen" "$nps"
+done
@@ -0,0 +1,45 @@
+#!/bin/sh
+
+#
+# Measures SMP scaling of the search: runs a fixed depth bench for an
+# increasing number of threads and reports time-to-depth, nodes and nps.
+#
+# Usage: smp_scaling.sh [engine] [depth] [max threads] [hash MB] [setoption ...]
+#
+# Every further argument is sent as a UCI option, e.g. to compare modes:
+#   smp_scaling.sh ./stockfish 16 256 1024 "SMPMode value LazySMP"
+#   smp_scaling.sh ./stockfish 16 256 1024 "SMPMode value ABDADA"
+#   smp_scaling.sh ./stockfish 16 256 1024 "SharedHistory value true"
+#
+
+engine=${1:-./stockfish}
+depth=${2:-16}
+maxthreads=${3:-$(nproc 2>/dev/null || echo 1)}
+hash=${4:-256}
+[ $# -gt 4 ] && shift 4 || set --
+
+printf '%8s %12s %14s %12s %10s\n' threads "time (ms)" nodes nps speedup
+
+threads=1
+basetime=
+while [ "$threads" -le "$maxthreads" ]; do
+  out=$(
+    {
+      for option; do
+        echo "setoption name $option"
+      done
+      echo "bench $hash $threads $depth default depth"
+      echo "quit"
+    } | "$engine" 2>&1
+  )
+
+  time=$(printf '%s\n' "$out" | awk '/^Total time/ {print $NF}')
+  nodes=$(printf '%s\n' "$out" | awk '/^Nodes searched/ {print $NF}')
+  nps=$(printf '%s\n' "$out" | awk '/^Nodes\/second/ {print $NF}')
+  [ -z "$basetime" ] && basetime=$time
+
+  printf '%8d %12d %14d %12d %10.2f\n' "$threads" "$time" "$nodes" "$nps" \
+    "$(echo "$basetime $time" | awk '{print $1 / $2}')"
+
+  threads=$((threads * 2))
+done
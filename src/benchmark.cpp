@@ -18,11 +18,22 @@
 
 #include "benchmark.h"
 
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <utility>
 #include <vector>
 
+#include "bitboard.h"
+#include "misc.h"
+#include "movegen.h"
+#include "posfile.h"
+#include "position.h"
+
 namespace {
 
 // clang-format off
@@ -98,17 +109,19 @@ namespace Stockfish::Benchmark {
 // Builds a list of UCI commands to be run by bench. There
 // are five parameters: TT size in MB, number of search threads that
 // should be used, the limit value spent for each position, a file name
-// where to look for positions in FEN format, and the type of the limit:
-// depth, perft, nodes and movetime (in milliseconds). Examples:
+// where to look for positions in FEN format or packed by the 'pack' command,
+// and the type of the limit: depth, perft, nodes and movetime (in milliseconds).
+// Examples:
 //
 // bench                            : search default positions up to depth 13
 // bench 64 1 15                    : search default positions up to depth 15 (TT = 64MB)
 // bench 64 1 100000 default nodes  : search default positions for 100K nodes each
 // bench 64 4 5000 current movetime : search current position with 4 threads for 5 sec
 // bench 16 1 5 blah perft          : run a perft 5 on positions in file "blah"
+// bench 16 1 1 blah.bin eval       : evaluate the packed positions in "blah.bin"
 std::vector<std::string> setup_bench(const std::string& currentFen, std::istream& is) {
 
-    std::vector<std::string> fens, list;
+    std::vector<std::string> fens, packed, list;
     std::string              go, token;
 
     // Assign default values to missing arguments
@@ -126,6 +139,17 @@ std::vector<std::string> setup_bench(const std::string& currentFen, std::istream
     else if (fenFile == "current")
         fens.push_back(currentFen);
 
+    // Files of packed positions are not read here, each position is loaded
+    // straight from the file by the 'position packed' command.
+    else if (PositionFile::is_packed(fenFile))
+    {
+        PositionFile file;
+        file.open(fenFile);
+
+        for (size_t i = 0; i < file.size(); ++i)
+            packed.push_back("position packed " + fenFile + " " + std::to_string(i));
+    }
+
     else
     {
         std::string   fen;
@@ -157,7 +181,188 @@ std::vector<std::string> setup_bench(const std::string& currentFen, std::istream
             list.emplace_back(go);
         }
 
+    for (const std::string& position : packed)
+    {
+        list.emplace_back(position);
+        list.emplace_back(go);
+    }
+
     return list;
 }
 
-}  // namespace Stockfish
\ No newline at end of file
+// Measures the speed of the sliding attacks backend. The squares and the
+// occupancies of all the sliders in the default bench positions are looked up
+// the given number of times for each of the rook, bishop and queen attacks.
+// Toggling the slider's own square does not change its attacks, but makes every
+// lookup depend on the previous ones, so that none can be optimized away.
+std::string attack_bench(size_t iterations) {
+
+    std::vector<std::pair<Square, Bitboard>> sliders;
+
+    for (const std::string& fen : Defaults)
+    {
+        if (fen.find("setoption") != std::string::npos)
+            continue;
+
+        StateInfo st;
+        Position  pos;
+        pos.set(fen.substr(0, fen.find(" moves")), true, &st);
+
+        for (Bitboard b = pos.pieces(BISHOP, ROOK) | pos.pieces(QUEEN); b;)
+            sliders.emplace_back(pop_lsb(b), pos.pieces());
+    }
+
+    std::ostringstream ss;
+    Bitboard           sum = 0;
+
+    ss << "Sliding attacks  : " << SlidersBackend;
+
+    for (PieceType pt : {ROOK, BISHOP, QUEEN})
+    {
+        TimePoint elapsed = now();
+
+        for (size_t i = 0; i < iterations; ++i)
+            for (const auto& [s, occupied] : sliders)
+                sum += attacks_bb(pt, s, occupied ^ (sum & s));
+
+        elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+        ss << (pt == ROOK     ? "\nRook attacks/s   : "
+               : pt == BISHOP ? "\nBishop attacks/s : "
+                              : "\nQueen attacks/s  : ")
+           << 1000 * iterations * sliders.size() / elapsed;
+    }
+
+    ss << "\nChecksum         : " << sum;
+
+    return ss.str();
+}
+
+// Measures how many positions per second are set up from their FEN string and
+// converted back to FEN, over the default bench positions.
+std::string fen_bench(size_t iterations) {
+
+    std::vector<std::string>               fens;
+    std::deque<StateInfo>                  states;
+    std::vector<std::unique_ptr<Position>> positions;
+    StateInfo                              st;
+    Position                               pos;
+    char                                   buf[Position::MaxFenLength];
+    size_t                                 sum = 0;
+
+    for (const std::string& fen : Defaults)
+        if (fen.find("setoption") == std::string::npos)
+            fens.push_back(fen.substr(0, fen.find(" moves")));
+
+    for (const std::string& fen : fens)
+    {
+        positions.push_back(std::make_unique<Position>());
+        positions.back()->set(fen, false, &states.emplace_back());
+    }
+
+    std::ostringstream ss;
+    TimePoint          elapsed = now();
+
+    for (size_t i = 0; i < iterations; ++i)
+        for (const std::string& fen : fens)
+            sum += pos.set(fen, false, &st).key() & 1;
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+    ss << "Parsed FENs/s    : " << 1000 * iterations * fens.size() / elapsed;
+
+    elapsed = now();
+
+    for (size_t i = 0; i < iterations; ++i)
+        for (const auto& p : positions)
+            sum += p->fen(buf) - buf;
+
+    elapsed = now() - elapsed + 1;
+    ss << "\nEmitted FENs/s   : " << 1000 * iterations * fens.size() / elapsed;
+
+    elapsed = now();
+
+    for (size_t i = 0; i < iterations; ++i)
+        for (const std::string& fen : fens)
+            sum += pos.set(fen, false, &st).fen(buf) - buf;
+
+    elapsed = now() - elapsed + 1;
+    ss << "\nRound trips/s    : " << 1000 * iterations * fens.size() / elapsed
+       << "\nChecksum         : " << sum;
+
+    return ss.str();
+}
+
+// Measures the static exchange evaluation of all the legal moves of the default
+// bench positions, once with a separate see_ge() call per move and once with the
+// batch version sharing the attackers of the target squares. Captures are tested
+// against a zero threshold and quiets against a negative one, as in the search.
+std::string see_bench(size_t iterations) {
+
+    struct Entry {
+        std::unique_ptr<Position> pos;
+        std::vector<Move>         moves;
+        std::vector<int>          thresholds;
+    };
+
+    std::deque<StateInfo> states;
+    std::vector<Entry>    entries;
+    size_t                count = 0, sum = 0, mismatches = 0;
+
+    for (const std::string& fen : Defaults)
+    {
+        if (fen.find("setoption") != std::string::npos)
+            continue;
+
+        Entry& e = entries.emplace_back();
+        e.pos    = std::make_unique<Position>();
+        e.pos->set(fen.substr(0, fen.find(" moves")), false, &states.emplace_back());
+
+        for (Move m : MoveList<LEGAL>(*e.pos))
+        {
+            e.moves.push_back(m);
+            e.thresholds.push_back(e.pos->capture_stage(m) ? 0 : -74);
+        }
+
+        count += e.moves.size();
+    }
+
+    std::ostringstream ss;
+    bool               results[MAX_MOVES];
+    TimePoint          elapsed = now();
+
+    for (size_t i = 0; i < iterations; ++i)
+        for (const Entry& e : entries)
+            for (size_t j = 0; j < e.moves.size(); ++j)
+                sum += e.pos->see_ge(e.moves[j], e.thresholds[j]);
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+    ss << "Single SEE/s     : " << 1000 * iterations * count / elapsed;
+
+    elapsed = now();
+
+    for (size_t i = 0; i < iterations; ++i)
+        for (const Entry& e : entries)
+        {
+            e.pos->see_ge(e.moves.data(), e.thresholds.data(), results, e.moves.size());
+
+            for (size_t j = 0; j < e.moves.size(); ++j)
+                sum += results[j];
+        }
+
+    elapsed = now() - elapsed + 1;
+    ss << "\nBatch SEE/s      : " << 1000 * iterations * count / elapsed;
+
+    for (const Entry& e : entries)
+    {
+        e.pos->see_ge(e.moves.data(), e.thresholds.data(), results, e.moves.size());
+
+        for (size_t j = 0; j < e.moves.size(); ++j)
+            mismatches += results[j] != e.pos->see_ge(e.moves[j], e.thresholds[j]);
+    }
+
+    ss << "\nMismatches       : " << mismatches << "\nChecksum         : " << sum;
+
+    return ss.str();
+}
+
+}  // namespace Stockfish
@@ -19,6 +19,7 @@
 #ifndef BENCHMARK_H_INCLUDED
 #define BENCHMARK_H_INCLUDED
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 #include <vector>
@@ -26,6 +27,9 @@
 namespace Stockfish::Benchmark {
 
 std::vector<std::string> setup_bench(const std::string&, std::istream&);
+std::string              attack_bench(size_t iterations);
+std::string              fen_bench(size_t iterations);
+std::string              see_bench(size_t iterations);
 
 }  // namespace Stockfish
 
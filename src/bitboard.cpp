@@ -34,15 +34,24 @@ Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
 Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
 Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 
+#if defined(USE_HQ_SLIDERS)
+HQMasks SliderMasks[SQUARE_NB];
+uint8_t FirstRankAttacks[FILE_NB][64];
+#elif !defined(USE_KOGGE_STONE_SLIDERS)
 Magic RookMagics[SQUARE_NB];
 Magic BishopMagics[SQUARE_NB];
+#endif
 
 namespace {
 
+#if defined(USE_HQ_SLIDERS)
+void init_hq();
+#elif !defined(USE_KOGGE_STONE_SLIDERS)
 Bitboard RookTable[0x19000];   // To store rook attacks
 Bitboard BishopTable[0x1480];  // To store bishop attacks
 
 void init_magics(PieceType pt, Bitboard table[], Magic magics[]);
+#endif
 
 // Returns the bitboard of target square for the given step
 // from the given square. If the step is off the board, returns empty bitboard.
@@ -82,8 +91,12 @@ void Bitboards::init() {
         for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2)
             SquareDistance[s1][s2] = std::max(distance<File>(s1, s2), distance<Rank>(s1, s2));
 
+#if defined(USE_HQ_SLIDERS)
+    init_hq();
+#elif !defined(USE_KOGGE_STONE_SLIDERS)
     init_magics(ROOK, RookTable, RookMagics);
     init_magics(BISHOP, BishopTable, BishopMagics);
+#endif
 
     for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
     {
@@ -115,6 +128,8 @@ void Bitboards::init() {
 
 namespace {
 
+#if !defined(USE_KOGGE_STONE_SLIDERS)
+
 Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
 
     Bitboard  attacks             = 0;
@@ -138,6 +153,35 @@ Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
 }
 
 
+    #if defined(USE_HQ_SLIDERS)
+
+// Computes the line masks of hyperbola quintessence, and the attacks along the
+// first rank indexed by file and by the six inner occupancy bits of the rank.
+void init_hq() {
+
+    for (Square s = SQ_A1; s <= SQ_H8; ++s)
+    {
+        SliderMasks[s].file = file_bb(s) ^ s;
+
+        for (Bitboard b = sliding_attack(BISHOP, s, 0); b;)
+        {
+            Square d = pop_lsb(b);
+
+            if ((file_of(d) > file_of(s)) == (rank_of(d) > rank_of(s)))
+                SliderMasks[s].diagonal |= d;
+            else
+                SliderMasks[s].antiDiagonal |= d;
+        }
+    }
+
+    for (File f = FILE_A; f <= FILE_H; ++f)
+        for (int occ = 0; occ < 64; ++occ)
+            FirstRankAttacks[f][occ] =
+              uint8_t(sliding_attack(ROOK, make_square(f, RANK_1), Bitboard(occ) << 1));
+}
+
+    #else
+
 // Computes all rook and bishop attacks at startup. Magic
 // bitboards are used to look up attacks of sliding pieces. As a reference see
 // www.chessprogramming.org/Magic_Bitboards. In particular, here we use the so
@@ -217,6 +261,8 @@ void init_magics(PieceType pt, Bitboard table[], Magic magics[]) {
         }
     }
 }
+    #endif
+#endif
 }
 
 }  // namespace Stockfish
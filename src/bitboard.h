@@ -28,6 +28,10 @@
 
 #include "types.h"
 
+#if defined(USE_KOGGE_STONE_SLIDERS) && defined(USE_AVX2)
+    #include <immintrin.h>
+#endif
+
 namespace Stockfish {
 
 namespace Bitboards {
@@ -64,6 +68,32 @@ extern Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
 extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 
 
+// The attacks of the sliding pieces are computed by one of several backends,
+// selected at compile time (see 'sliders' in the Makefile):
+//
+// magic | Fancy magic bitboards, or PEXT bitboards when USE_PEXT is defined.
+//       | Fastest lookup, but the tables take about 840 KB.
+// hq    | Hyperbola quintessence for files and diagonals, plus a 512 byte table
+//       | for the ranks. About 2 KB of tables.
+// kogge | Kogge-Stone occluded fills, vectorized over the four directions with
+//       | AVX2 when available. No tables at all.
+#if defined(USE_HQ_SLIDERS)
+constexpr const char* SlidersBackend = "hq";
+
+// HQMasks holds the lines through a square, without the square itself
+struct HQMasks {
+    Bitboard file, diagonal, antiDiagonal;
+};
+
+extern HQMasks SliderMasks[SQUARE_NB];
+extern uint8_t FirstRankAttacks[FILE_NB][64];
+
+#elif defined(USE_KOGGE_STONE_SLIDERS)
+constexpr const char* SlidersBackend = "kogge";
+
+#else
+constexpr const char* SlidersBackend = HasPext ? "pext" : "magic";
+
 // Magic holds all magic bitboards relevant data for a single square
 struct Magic {
     Bitboard  mask;
@@ -88,6 +118,7 @@ struct Magic {
 
 extern Magic RookMagics[SQUARE_NB];
 extern Magic BishopMagics[SQUARE_NB];
+#endif
 
 constexpr Bitboard square_bb(Square s) {
     assert(is_ok(s));
@@ -218,6 +249,142 @@ inline Bitboard attacks_bb(Square s) {
 }
 
 
+#if defined(USE_HQ_SLIDERS)
+
+// Reverses the order of the ranks of a bitboard
+inline Bitboard byteswap(Bitboard b) {
+
+    #if defined(__GNUC__)
+    return __builtin_bswap64(b);
+    #elif defined(_MSC_VER)
+    return _byteswap_uint64(b);
+    #else
+    b = ((b >> 8) & 0x00FF00FF00FF00FFULL) | ((b & 0x00FF00FF00FF00FFULL) << 8);
+    b = ((b >> 16) & 0x0000FFFF0000FFFFULL) | ((b & 0x0000FFFF0000FFFFULL) << 16);
+    return (b >> 32) | (b << 32);
+    #endif
+}
+
+// Attacks along a line with at most one square per rank, using the o^(o-2r)
+// trick in both directions: the reverse direction is handled by swapping the
+// ranks, so that the subtraction carries towards the slider.
+inline Bitboard hq_line_attacks(Square s, Bitboard occupied, Bitboard mask) {
+
+    Bitboard forward = occupied & mask;
+    Bitboard reverse = byteswap(forward);
+
+    forward -= square_bb(s);
+    reverse -= square_bb(flip_rank(s));
+
+    return (forward ^ byteswap(reverse)) & mask;
+}
+
+inline Bitboard hq_rank_attacks(Square s, Bitboard occupied) {
+
+    const int shift = 8 * rank_of(s);
+    return Bitboard(FirstRankAttacks[file_of(s)][(occupied >> (shift + 1)) & 63]) << shift;
+}
+
+template<PieceType Pt>
+inline Bitboard slider_attacks(Square s, Bitboard occupied) {
+
+    const HQMasks& m = SliderMasks[s];
+
+    return Pt == BISHOP ? hq_line_attacks(s, occupied, m.diagonal)
+                            | hq_line_attacks(s, occupied, m.antiDiagonal)
+                        : hq_line_attacks(s, occupied, m.file) | hq_rank_attacks(s, occupied);
+}
+
+#elif defined(USE_KOGGE_STONE_SLIDERS) && defined(USE_AVX2)
+
+// Kogge-Stone fills along four directions at once, one per 64-bit lane. Left
+// and right shifts are both applied to every lane, with a shift count of 64 or
+// more, which yields zero, disabling the unwanted one. The wrap masks stop the
+// fills from leaking across the A and H files.
+template<PieceType Pt>
+inline Bitboard slider_attacks(Square s, Bitboard occupied) {
+
+    constexpr Bitboard NotA = ~FileABB, NotH = ~FileHBB, All = ~Bitboard(0);
+
+    const __m256i wrap = Pt == BISHOP ? _mm256_setr_epi64x(NotA, NotH, NotA, NotH)
+                                      : _mm256_setr_epi64x(All, NotA, All, NotH);
+    __m256i       l    = Pt == BISHOP ? _mm256_setr_epi64x(9, 7, 64, 64)  // NE, NW
+                                      : _mm256_setr_epi64x(8, 1, 64, 64);  // N, E
+    __m256i       r    = Pt == BISHOP ? _mm256_setr_epi64x(64, 64, 7, 9)  // SE, SW
+                                      : _mm256_setr_epi64x(64, 64, 8, 1);  // S, W
+
+    const __m256i l1 = l, r1 = r;
+
+    auto sh = [](__m256i b, __m256i left, __m256i right) {
+        return _mm256_or_si256(_mm256_sllv_epi64(b, left), _mm256_srlv_epi64(b, right));
+    };
+
+    __m256i gen = _mm256_set1_epi64x(int64_t(square_bb(s)));
+    __m256i pro = _mm256_andnot_si256(_mm256_set1_epi64x(int64_t(occupied)), wrap);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, sh(gen, l, r)));
+        pro = _mm256_and_si256(pro, sh(pro, l, r));
+        l   = _mm256_add_epi64(l, l);
+        r   = _mm256_add_epi64(r, r);
+    }
+
+    __m256i attacks = _mm256_and_si256(sh(gen, l1, r1), wrap);
+    __m128i b       = _mm_or_si128(_mm256_castsi256_si128(attacks),
+                                   _mm256_extracti128_si256(attacks, 1));
+
+    return Bitboard(_mm_cvtsi128_si64(_mm_or_si128(b, _mm_unpackhi_epi64(b, b))));
+}
+
+#elif defined(USE_KOGGE_STONE_SLIDERS)
+
+// Kogge-Stone occluded fill in direction D, see
+// www.chessprogramming.org/Kogge-Stone_Algorithm
+template<Direction D>
+inline Bitboard kogge_stone_attacks(Square s, Bitboard empty) {
+
+    constexpr Bitboard Wrap = (D == EAST || D == NORTH_EAST || D == SOUTH_EAST) ? ~FileABB
+                            : (D == WEST || D == NORTH_WEST || D == SOUTH_WEST) ? ~FileHBB
+                                                                                : ~Bitboard(0);
+
+    auto sh = [](Bitboard b, int n) { return n > 0 ? b << n : b >> -n; };
+
+    Bitboard gen = square_bb(s), pro = empty & Wrap;
+
+    gen |= pro & sh(gen, D);
+    pro &= sh(pro, D);
+    gen |= pro & sh(gen, 2 * D);
+    pro &= sh(pro, 2 * D);
+    gen |= pro & sh(gen, 4 * D);
+
+    return sh(gen, D) & Wrap;
+}
+
+template<PieceType Pt>
+inline Bitboard slider_attacks(Square s, Bitboard occupied) {
+
+    const Bitboard empty = ~occupied;
+
+    return Pt == BISHOP
+           ? kogge_stone_attacks<NORTH_EAST>(s, empty) | kogge_stone_attacks<NORTH_WEST>(s, empty)
+               | kogge_stone_attacks<SOUTH_EAST>(s, empty) | kogge_stone_attacks<SOUTH_WEST>(s, empty)
+           : kogge_stone_attacks<NORTH>(s, empty) | kogge_stone_attacks<EAST>(s, empty)
+               | kogge_stone_attacks<SOUTH>(s, empty) | kogge_stone_attacks<WEST>(s, empty);
+}
+
+#else
+
+template<PieceType Pt>
+inline Bitboard slider_attacks(Square s, Bitboard occupied) {
+
+    const Magic& m = Pt == BISHOP ? BishopMagics[s] : RookMagics[s];
+    return m.attacks[m.index(occupied)];
+}
+
+#endif
+
+
 // Returns the attacks by the given piece
 // assuming the board is occupied according to the passed Bitboard.
 // Sliding piece attacks do not continue passed an occupied square.
@@ -229,9 +396,8 @@ inline Bitboard attacks_bb(Square s, Bitboard occupied) {
     switch (Pt)
     {
     case BISHOP :
-        return BishopMagics[s].attacks[BishopMagics[s].index(occupied)];
     case ROOK :
-        return RookMagics[s].attacks[RookMagics[s].index(occupied)];
+        return slider_attacks<Pt>(s, occupied);
     case QUEEN :
         return attacks_bb<BISHOP>(s, occupied) | attacks_bb<ROOK>(s, occupied);
     default :
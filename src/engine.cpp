@@ -18,10 +18,12 @@
 
 #include "engine.h"
 
+#include <algorithm>
 #include <cassert>
 #include <deque>
 #include <iosfwd>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <sstream>
 #include <string_view>
@@ -50,15 +52,18 @@ constexpr int  MaxHashMB = Is64Bit ? 33554432 : 2048;
 Engine::Engine(std::string path) :
     binaryDirectory(CommandLine::get_binary_directory(path)),
     numaContext(NumaConfig::from_system()),
-    states(new std::deque<StateInfo>(1)),
     threads(),
     networks(
       numaContext,
       NN::Networks(
         NN::NetworkBig({EvalFileDefaultNameBig, "None", ""}, NN::EmbeddedNNUEType::BIG),
         NN::NetworkSmall({EvalFileDefaultNameSmall, "None", ""}, NN::EmbeddedNNUEType::SMALL))) {
+    states         = &arenas[0];
+    statesSearched = false;
     pos.set(StartFEN, false, &states->back());
-    capSq = SQ_NONE;
+    capSq            = SQ_NONE;
+    positionFen      = StartFEN;
+    positionChess960 = false;
 
     options["Debug Log File"] << Option("", [](const Option& o) {
         start_logger(o);
@@ -72,7 +77,21 @@ Engine::Engine(std::string path) :
 
     options["Threads"] << Option(1, 1, 1024, [this](const Option&) {
         resize_threads();
-        return thread_binding_information_as_string();
+        const auto binding = thread_binding_information_as_string();
+        return (binding.empty() ? "" : binding + "\n") + thread_allocation_information_as_string();
+    });
+
+    options["SMPMode"] << Option("LazySMP var LazySMP var ABDADA var Deterministic", "LazySMP",
+                                 [this](const Option&) {
+                                     // Histories are never shared in deterministic mode
+                                     if (options["SharedHistory"])
+                                         resize_threads();
+                                     return std::nullopt;
+                                 });
+
+    options["SharedHistory"] << Option(false, [this](const Option&) {
+        resize_threads();
+        return thread_allocation_information_as_string();
     });
 
     options["Hash"] << Option(16, 1, MaxHashMB, [this](const Option& o) {
@@ -93,13 +112,37 @@ Engine::Engine(std::string path) :
     options["UCI_LimitStrength"] << Option(false);
     options["UCI_Elo"] << Option(1320, 1320, 3190);
     options["UCI_ShowWDL"] << Option(false);
-    options["SyzygyPath"] << Option("<empty>", [](const Option& o) {
-        Tablebases::init(o);
-        return std::nullopt;
+    options["SyzygyPath"] << Option("<empty>", [this](const Option& o) {
+        Tablebases::init(o, options["SyzygyIndexFile"]);
+        return preload_tablebases();
+    });
+    options["SyzygyIndexFile"] << Option("<empty>", [this](const Option& o) {
+        Tablebases::init(options["SyzygyPath"], o);
+        return preload_tablebases();
     });
     options["SyzygyProbeDepth"] << Option(1, 1, 100);
     options["Syzygy50MoveRule"] << Option(true);
     options["SyzygyProbeLimit"] << Option(7, 0, 7);
+    options["SyzygyPreload"] << Option(0, 0, 7, [this](const Option&) {
+        return preload_tablebases();
+    });
+    options["SyzygyLockWDL"] << Option(false, [this](const Option&) {
+        return preload_tablebases();
+    });
+    options["SyzygyWDLCache"] << Option(16, 0, 4096, [this](const Option& o) {
+        wait_for_search_finished();
+        Tablebases::set_wdl_cache_size(o);
+        return std::nullopt;
+    });
+    options["SyzygyMemoryLimit"] << Option(0, 0, 1048576, [this](const Option& o) {
+        wait_for_search_finished();
+        Tablebases::set_memory_limit(o);
+        return std::nullopt;
+    });
+    options["SyzygyStats"] << Option(false, [](const Option& o) {
+        Tablebases::set_stats(o);
+        return std::nullopt;
+    });
     options["EvalFile"] << Option(EvalFileDefaultNameBig, [this](const Option& o) {
         load_big_network(o);
         return std::nullopt;
@@ -109,14 +152,17 @@ Engine::Engine(std::string path) :
         return std::nullopt;
     });
 
+    Tablebases::set_wdl_cache_size(options["SyzygyWDLCache"]);
     load_networks();
     resize_threads();
 }
 
-std::uint64_t Engine::perft(const std::string& fen, Depth depth, bool isChess960) {
+std::uint64_t Engine::perft(
+  const std::string& fen, Depth depth, bool isChess960, size_t threadCount, size_t hashMB) {
     verify_networks();
+    wait_for_search_finished();
 
-    return Benchmark::perft(fen, depth, isChess960);
+    return Benchmark::perft(fen, depth, isChess960, threads, threadCount, hashMB);
 }
 
 void Engine::go(Search::LimitsType& limits) {
@@ -124,7 +170,8 @@ void Engine::go(Search::LimitsType& limits) {
     verify_networks();
     limits.capSq = capSq;
 
-    threads.start_thinking(options, pos, states, limits);
+    threads.start_thinking(options, pos, *states, limits);
+    statesSearched = true;
 }
 void Engine::stop() { threads.stop = true; }
 
@@ -134,8 +181,53 @@ void Engine::search_clear() {
     tt.clear(threads);
     threads.clear();
 
+    // Free mapped files, but keep the preloaded ones, which are loaded again
+    // only when the SyzygyPath, SyzygyPreload or SyzygyLockWDL option changes.
     // @TODO wont work with multiple instances
-    Tablebases::init(options["SyzygyPath"]);  // Free mapped files
+    if (!int(options["SyzygyPreload"]))
+        Tablebases::init(options["SyzygyPath"], options["SyzygyIndexFile"]);
+}
+
+// Maps and reads into memory the tablebases with up to the given number of
+// pieces, optionally locking the WDL ones there, see the SyzygyLockWDL option.
+// The WDL tables locked by a previous preload are unlocked first.
+std::string Engine::preload_tablebases(int maxPieces) {
+    wait_for_search_finished();
+    return Tablebases::preload(maxPieces, options["SyzygyLockWDL"]);
+}
+
+// Preloads the tablebases as set by the SyzygyPreload option, if enabled, else
+// unlocks the WDL tables that a previous preload locked in memory.
+std::optional<std::string> Engine::preload_tablebases() {
+    if (!int(options["SyzygyPreload"]))
+    {
+        wait_for_search_finished();
+        Tablebases::unlock_wdl();
+        return std::nullopt;
+    }
+
+    return preload_tablebases(options["SyzygyPreload"]);
+}
+
+// Times the mapping of all the tablebases, which reloads them first, so the
+// search must not be probing them. The reload empties the WDL cache and resets
+// the probe statistics, and the tables set by SyzygyPreload are loaded again.
+std::string Engine::tablebase_map_bench(size_t threadCount) {
+    wait_for_search_finished();
+
+    std::string result = Tablebases::map_bench(threadCount);
+
+    if (std::optional<std::string> preloaded = preload_tablebases())
+        result += "\n" + *preloaded;
+
+    return result;
+}
+
+// Measures the DTZ probes, which switches the block cache off for a while, so
+// the search must not be probing meanwhile.
+std::string Engine::tablebase_dtz_bench(int maxPieces, size_t positionsPerTable) {
+    wait_for_search_finished();
+    return Tablebases::dtz_bench(maxPieces, positionsPerTable);
 }
 
 void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)>&& f) {
@@ -157,20 +249,63 @@ void Engine::set_on_bestmove(std::function<void(std::string_view, std::string_vi
 void Engine::wait_for_search_finished() { threads.main_thread()->wait_for_search_finished(); }
 
 void Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
-    // Drop the old state and create a new one
-    states = StateListPtr(new std::deque<StateInfo>(1));
-    pos.set(fen, options["UCI_Chess960"], &states->back());
+    const bool chess960 = options["UCI_Chess960"];
+    size_t     idx      = 0;
+
+    // During a game the new move list usually extends the current one, in which
+    // case only the new moves are played, on top of the existing states. This is
+    // safe even while searching, the search never reads the appended states.
+    if (fen == positionFen && chess960 == positionChess960 && moves.size() >= positionMoves.size()
+        && std::equal(positionMoves.begin(), positionMoves.end(), moves.begin()))
+        idx = positionMoves.size();
+    else
+    {
+        pos.set(fen, chess960, &reset_states());
+
+        capSq            = SQ_NONE;
+        positionFen      = fen;
+        positionChess960 = chess960;
+        positionMoves.clear();
+    }
+
+    play_moves(moves, idx);
+}
+
+void Engine::set_position(const PackedPosition& pp, const std::vector<std::string>& moves) {
+    pos.set_from_packed(pp, options["UCI_Chess960"], &reset_states());
 
     capSq = SQ_NONE;
-    for (const auto& move : moves)
+    positionFen.clear();  // The next set_position() must start from scratch
+    positionMoves.clear();
+
+    play_moves(moves, 0);
+}
+
+// Drops the old states, keeping their memory for the new ones, and returns the
+// state for the new root. A search may still be reading the arena it was started
+// on, so in that case the other arena is used. That one was last used by an
+// earlier search, which has finished before the latest one was started.
+StateInfo& Engine::reset_states() {
+    if (statesSearched)
     {
-        auto m = UCIEngine::to_move(pos, move);
+        states         = states == &arenas[0] ? &arenas[1] : &arenas[0];
+        statesSearched = false;
+    }
+
+    return states->reset();
+}
+
+// Plays the moves from the given index on, on top of the current position
+void Engine::play_moves(const std::vector<std::string>& moves, size_t idx) {
+    for (; idx < moves.size(); ++idx)
+    {
+        auto m = UCIEngine::to_move(pos, moves[idx]);
 
         if (m == Move::none())
             break;
 
-        states->emplace_back();
-        pos.do_move(m, states->back());
+        pos.do_move(m, states->emplace_back());
+        positionMoves.push_back(moves[idx]);
 
         capSq          = SQ_NONE;
         DirtyPiece& dp = states->back().dirtyPiece;
@@ -270,7 +405,17 @@ OptionsMap&       Engine::get_options() { return options; }
 
 std::string Engine::fen() const { return pos.fen(); }
 
-void Engine::flip() { pos.flip(); }
+void Engine::flip() {
+    pos.flip();
+    positionFen.clear();  // The next set_position() must start from scratch
+}
+
+// Statistics of the searches completed so far, a running search is not waited
+// for since it can be infinite.
+std::string Engine::search_stats() const {
+    std::scoped_lock<std::mutex> lk(threads.searchStatsMutex);
+    return threads.searchStats.to_string();
+}
 
 std::string Engine::visualize() const {
     std::stringstream ss;
@@ -321,4 +466,18 @@ std::string Engine::thread_binding_information_as_string() const {
     return ss.str();
 }
 
+std::string Engine::thread_allocation_information_as_string() const {
+    const size_t      size = threads.worker_memory_footprint();
+    std::stringstream ss;
+
+    ss << "Search Worker Memory: " << threads.size() << " x " << (size + 512 * 1024) / (1024 * 1024)
+       << " MiB";
+
+    if (threads.shared_histories_count())
+        ss << " + " << threads.shared_histories_count() << " x "
+           << (sizeof(Search::Histories) + 512 * 1024) / (1024 * 1024) << " MiB shared histories";
+
+    return ss.str();
+}
+
 }
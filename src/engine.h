@@ -57,7 +57,11 @@ class Engine {
 
     ~Engine() { wait_for_search_finished(); }
 
-    std::uint64_t perft(const std::string& fen, Depth depth, bool isChess960);
+    std::uint64_t perft(const std::string& fen,
+                        Depth              depth,
+                        bool               isChess960,
+                        size_t             threadCount = 1,
+                        size_t             hashMB      = 0);
 
     // non blocking call to start searching
     void go(Search::LimitsType&);
@@ -68,6 +72,7 @@ class Engine {
     void wait_for_search_finished();
     // set a new position, moves are in UCI format
     void set_position(const std::string& fen, const std::vector<std::string>& moves);
+    void set_position(const PackedPosition& pp, const std::vector<std::string>& moves);
 
     // modifiers
 
@@ -77,6 +82,11 @@ class Engine {
     void set_ponderhit(bool);
     void search_clear();
 
+    std::string                preload_tablebases(int maxPieces);
+    std::optional<std::string> preload_tablebases();
+    std::string                tablebase_map_bench(size_t threadCount);
+    std::string                tablebase_dtz_bench(int maxPieces, size_t positionsPerTable);
+
     void set_on_update_no_moves(std::function<void(const InfoShort&)>&&);
     void set_on_update_full(std::function<void(const InfoFull&)>&&);
     void set_on_iter(std::function<void(const InfoIter&)>&&);
@@ -92,7 +102,8 @@ class Engine {
 
     // utility functions
 
-    void trace_eval() const;
+    void        trace_eval() const;
+    std::string search_stats() const;
 
     const OptionsMap& get_options() const;
     OptionsMap&       get_options();
@@ -104,15 +115,26 @@ class Engine {
     std::string                            get_numa_config_as_string() const;
     std::string                            numa_config_information_as_string() const;
     std::string                            thread_binding_information_as_string() const;
+    std::string                            thread_allocation_information_as_string() const;
 
    private:
+    StateInfo& reset_states();
+    void       play_moves(const std::vector<std::string>& moves, size_t idx);
+
     const std::string binaryDirectory;
 
     NumaReplicationContext numaContext;
 
-    Position     pos;
-    StateListPtr states;
-    Square       capSq;
+    Position    pos;
+    StateArena  arenas[2];
+    StateArena* states;  // The arena of the current game history
+    bool        statesSearched;
+    Square      capSq;
+
+    // What the current position was set from, see set_position()
+    std::string              positionFen;
+    std::vector<std::string> positionMoves;
+    bool                     positionChess960;
 
     OptionsMap                           options;
     ThreadPool                           threads;
@@ -224,6 +224,317 @@ ExtMove* generate_all(const Position& pos, ExtMove* moveList) {
     return moveList;
 }
 
+
+// Legal pawn moves of the given pawns, restricted to the destination squares in
+// destMask. En passant captures are generated separately.
+template<Color Us>
+ExtMove* generate_legal_pawn_moves(const Position& pos,
+                                   ExtMove*        moveList,
+                                   Bitboard        pawns,
+                                   Bitboard        destMask) {
+
+    constexpr Bitboard  TRank7BB = (Us == WHITE ? Rank7BB : Rank2BB);
+    constexpr Bitboard  TRank3BB = (Us == WHITE ? Rank3BB : Rank6BB);
+    constexpr Direction Up       = pawn_push(Us);
+    constexpr Direction UpRight  = (Us == WHITE ? NORTH_EAST : SOUTH_WEST);
+    constexpr Direction UpLeft   = (Us == WHITE ? NORTH_WEST : SOUTH_EAST);
+
+    const Bitboard emptySquares = ~pos.pieces();
+    const Bitboard enemies      = pos.pieces(~Us) & destMask;
+
+    Bitboard pawnsOn7    = pawns & TRank7BB;
+    Bitboard pawnsNotOn7 = pawns & ~TRank7BB;
+
+    // Single and double pawn pushes, no promotions
+    Bitboard b1 = shift<Up>(pawnsNotOn7) & emptySquares;
+    Bitboard b2 = shift<Up>(b1 & TRank3BB) & emptySquares & destMask;
+    b1 &= destMask;
+
+    while (b1)
+    {
+        Square to   = pop_lsb(b1);
+        *moveList++ = Move(to - Up, to);
+    }
+
+    while (b2)
+    {
+        Square to   = pop_lsb(b2);
+        *moveList++ = Move(to - Up - Up, to);
+    }
+
+    // Promotions and underpromotions
+    if (pawnsOn7)
+    {
+        b1          = shift<UpRight>(pawnsOn7) & enemies;
+        b2          = shift<UpLeft>(pawnsOn7) & enemies;
+        Bitboard b3 = shift<Up>(pawnsOn7) & emptySquares & destMask;
+
+        while (b1)
+            moveList = make_promotions<NON_EVASIONS, UpRight, true>(moveList, pop_lsb(b1));
+
+        while (b2)
+            moveList = make_promotions<NON_EVASIONS, UpLeft, true>(moveList, pop_lsb(b2));
+
+        while (b3)
+            moveList = make_promotions<NON_EVASIONS, Up, false>(moveList, pop_lsb(b3));
+    }
+
+    // Standard captures
+    b1 = shift<UpRight>(pawnsNotOn7) & enemies;
+    b2 = shift<UpLeft>(pawnsNotOn7) & enemies;
+
+    while (b1)
+    {
+        Square to   = pop_lsb(b1);
+        *moveList++ = Move(to - UpRight, to);
+    }
+
+    while (b2)
+    {
+        Square to   = pop_lsb(b2);
+        *moveList++ = Move(to - UpLeft, to);
+    }
+
+    return moveList;
+}
+
+
+template<Color Us, PieceType Pt>
+ExtMove* generate_legal_moves(const Position& pos,
+                              ExtMove*        moveList,
+                              Bitboard        target,
+                              Bitboard        pinned,
+                              Square          ksq) {
+
+    // A pinned knight can never move
+    Bitboard bb = pos.pieces(Us, Pt) & (Pt == KNIGHT ? ~pinned : ~Bitboard(0));
+
+    while (bb)
+    {
+        Square   from = pop_lsb(bb);
+        Bitboard b    = attacks_bb<Pt>(from, pos.pieces()) & target;
+
+        // A pinned piece can only move along the pin ray
+        if (pinned & from)
+            b &= line_bb(ksq, from);
+
+        while (b)
+            *moveList++ = Move(from, pop_lsb(b));
+    }
+
+    return moveList;
+}
+
+
+// Pawns that can legally capture en passant. Being rare, the captures are verified
+// by testing whether the king is attacked by a slider once both pawns are gone.
+// When in check the capture must also remove the checker or block the check.
+template<Color Us>
+Bitboard legal_ep_capturers(const Position& pos, Bitboard checkMask, Square ksq) {
+
+    constexpr Color Them = ~Us;
+
+    const Square epSquare = pos.ep_square();
+    const Square capsq    = epSquare - pawn_push(Us);
+    Bitboard     result   = 0;
+
+    if (pos.checkers() && !(checkMask & epSquare) && !(pos.checkers() & capsq))
+        return 0;
+
+    for (Bitboard b = pos.pieces(Us, PAWN) & pawn_attacks_bb(Them, epSquare); b;)
+    {
+        Square   from     = pop_lsb(b);
+        Bitboard occupied = (pos.pieces() ^ from ^ capsq) | epSquare;
+
+        if (!(attacks_bb<ROOK>(ksq, occupied) & pos.pieces(Them, QUEEN, ROOK))
+            && !(attacks_bb<BISHOP>(ksq, occupied) & pos.pieces(Them, QUEEN, BISHOP)))
+            result |= from;
+    }
+
+    return result;
+}
+
+
+// Squares the king can move to, not attacked once the king has left its square
+template<Color Us>
+Bitboard legal_king_targets(const Position& pos, Square ksq) {
+
+    const Bitboard occupied = pos.pieces() ^ ksq;
+    Bitboard       result   = 0;
+
+    for (Bitboard b = attacks_bb<KING>(ksq) & ~pos.pieces(Us); b;)
+    {
+        Square to = pop_lsb(b);
+        if (!(pos.attackers_to(to, occupied) & pos.pieces(~Us)))
+            result |= to;
+    }
+
+    return result;
+}
+
+
+// Whether castling is legal: no square the king passes through is attacked and,
+// in Chess960, the rook is not shielding the king from a check along the back rank.
+template<Color Us>
+bool legal_castling(const Position& pos, CastlingRights cr, Square ksq) {
+
+    if (pos.castling_impeded(cr) || !pos.can_castle(cr))
+        return false;
+
+    const Square    rsq  = pos.castling_rook_square(cr);
+    const Square    kto  = relative_square(Us, rsq > ksq ? SQ_G1 : SQ_C1);
+    const Direction step = kto > ksq ? WEST : EAST;
+
+    if (pos.is_chess960() && (pos.blockers_for_king(Us) & rsq))
+        return false;
+
+    for (Square s = kto; s != ksq; s += step)
+        if (pos.attackers_to(s) & pos.pieces(~Us))
+            return false;
+
+    return true;
+}
+
+
+// Generates the legal moves directly, using the pinned pieces and, when in check,
+// the squares that block or capture the checker, so that the moves do not need
+// to be validated one by one with Position::legal().
+template<Color Us>
+ExtMove* generate_legal(const Position& pos, ExtMove* moveList) {
+
+    const Square   ksq      = pos.square<KING>(Us);
+    const Bitboard checkers = pos.checkers();
+    const Bitboard pinned   = pos.blockers_for_king(Us) & pos.pieces(Us);
+
+    // Skip generating non-king moves when in double check
+    if (!more_than_one(checkers))
+    {
+        const Bitboard checkMask = checkers ? between_bb(ksq, lsb(checkers)) : ~Bitboard(0);
+        const Bitboard target    = ~pos.pieces(Us) & checkMask;
+        const Bitboard pawns     = pos.pieces(Us, PAWN);
+
+        moveList = generate_legal_pawn_moves<Us>(pos, moveList, pawns & ~pinned, checkMask);
+
+        for (Bitboard b = pawns & pinned; b;)
+        {
+            Square s = pop_lsb(b);
+            moveList =
+              generate_legal_pawn_moves<Us>(pos, moveList, square_bb(s), checkMask & line_bb(ksq, s));
+        }
+
+        if (pos.ep_square() != SQ_NONE)
+            for (Bitboard b = legal_ep_capturers<Us>(pos, checkMask, ksq); b;)
+                *moveList++ = Move::make<EN_PASSANT>(pop_lsb(b), pos.ep_square());
+
+        moveList = generate_legal_moves<Us, KNIGHT>(pos, moveList, target, pinned, ksq);
+        moveList = generate_legal_moves<Us, BISHOP>(pos, moveList, target, pinned, ksq);
+        moveList = generate_legal_moves<Us, ROOK>(pos, moveList, target, pinned, ksq);
+        moveList = generate_legal_moves<Us, QUEEN>(pos, moveList, target, pinned, ksq);
+    }
+
+    for (Bitboard b = legal_king_targets<Us>(pos, ksq); b;)
+        *moveList++ = Move(ksq, pop_lsb(b));
+
+    if (!checkers && pos.can_castle(Us & ANY_CASTLING))
+        for (CastlingRights cr : {Us & KING_SIDE, Us & QUEEN_SIDE})
+            if (legal_castling<Us>(pos, cr, ksq))
+                *moveList++ = Move::make<CASTLING>(ksq, pos.castling_rook_square(cr));
+
+    return moveList;
+}
+
+
+// Number of legal pawn moves of the given pawns, with the same restrictions as
+// generate_legal_pawn_moves(). Each promotion counts as four moves.
+template<Color Us>
+int count_legal_pawn_moves(const Position& pos, Bitboard pawns, Bitboard destMask) {
+
+    constexpr Bitboard  TRank8BB = (Us == WHITE ? Rank8BB : Rank1BB);
+    constexpr Bitboard  TRank3BB = (Us == WHITE ? Rank3BB : Rank6BB);
+    constexpr Direction Up       = pawn_push(Us);
+    constexpr Direction UpRight  = (Us == WHITE ? NORTH_EAST : SOUTH_WEST);
+    constexpr Direction UpLeft   = (Us == WHITE ? NORTH_WEST : SOUTH_EAST);
+
+    const Bitboard emptySquares = ~pos.pieces();
+    const Bitboard enemies      = pos.pieces(~Us) & destMask;
+
+    Bitboard b1 = shift<Up>(pawns) & emptySquares;
+    Bitboard b2 = shift<Up>(b1 & TRank3BB) & emptySquares & destMask;
+    b1 &= destMask;
+
+    Bitboard b3 = shift<UpRight>(pawns) & enemies;
+    Bitboard b4 = shift<UpLeft>(pawns) & enemies;
+
+    // Pushes and captures landing on the last rank are promotions
+    const int promotions = popcount((b1 | b3) & TRank8BB) + popcount(b4 & TRank8BB);
+
+    return popcount(b1) + popcount(b2) + popcount(b3) + popcount(b4) + 3 * promotions;
+}
+
+
+template<Color Us, PieceType Pt>
+int count_legal_moves(const Position& pos, Bitboard target, Bitboard pinned, Square ksq) {
+
+    Bitboard bb  = pos.pieces(Us, Pt) & (Pt == KNIGHT ? ~pinned : ~Bitboard(0));
+    int      cnt = 0;
+
+    while (bb)
+    {
+        Square   from = pop_lsb(bb);
+        Bitboard b    = attacks_bb<Pt>(from, pos.pieces()) & target;
+
+        if (pinned & from)
+            b &= line_bb(ksq, from);
+
+        cnt += popcount(b);
+    }
+
+    return cnt;
+}
+
+
+// Counterpart of generate_legal() that only counts the moves, using popcounts
+// of the destination bitboards instead of writing them to a move list.
+template<Color Us>
+int count_legal(const Position& pos) {
+
+    const Square   ksq      = pos.square<KING>(Us);
+    const Bitboard checkers = pos.checkers();
+    const Bitboard pinned   = pos.blockers_for_king(Us) & pos.pieces(Us);
+    int            cnt      = 0;
+
+    if (!more_than_one(checkers))
+    {
+        const Bitboard checkMask = checkers ? between_bb(ksq, lsb(checkers)) : ~Bitboard(0);
+        const Bitboard target    = ~pos.pieces(Us) & checkMask;
+        const Bitboard pawns     = pos.pieces(Us, PAWN);
+
+        cnt += count_legal_pawn_moves<Us>(pos, pawns & ~pinned, checkMask);
+
+        for (Bitboard b = pawns & pinned; b;)
+        {
+            Square s = pop_lsb(b);
+            cnt += count_legal_pawn_moves<Us>(pos, square_bb(s), checkMask & line_bb(ksq, s));
+        }
+
+        if (pos.ep_square() != SQ_NONE)
+            cnt += popcount(legal_ep_capturers<Us>(pos, checkMask, ksq));
+
+        cnt += count_legal_moves<Us, KNIGHT>(pos, target, pinned, ksq);
+        cnt += count_legal_moves<Us, BISHOP>(pos, target, pinned, ksq);
+        cnt += count_legal_moves<Us, ROOK>(pos, target, pinned, ksq);
+        cnt += count_legal_moves<Us, QUEEN>(pos, target, pinned, ksq);
+    }
+
+    cnt += popcount(legal_king_targets<Us>(pos, ksq));
+
+    if (!checkers && pos.can_castle(Us & ANY_CASTLING))
+        for (CastlingRights cr : {Us & KING_SIDE, Us & QUEEN_SIDE})
+            cnt += legal_castling<Us>(pos, cr, ksq);
+
+    return cnt;
+}
+
 }  // namespace
 
 
@@ -260,21 +571,16 @@ template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 template<>
 ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList) {
 
-    Color    us     = pos.side_to_move();
-    Bitboard pinned = pos.blockers_for_king(us) & pos.pieces(us);
-    Square   ksq    = pos.square<KING>(us);
-    ExtMove* cur    = moveList;
+    return pos.side_to_move() == WHITE ? generate_legal<WHITE>(pos, moveList)
+                                       : generate_legal<BLACK>(pos, moveList);
+}
+
 
-    moveList =
-      pos.checkers() ? generate<EVASIONS>(pos, moveList) : generate<NON_EVASIONS>(pos, moveList);
-    while (cur != moveList)
-        if (((pinned & cur->from_sq()) || cur->from_sq() == ksq || cur->type_of() == EN_PASSANT)
-            && !pos.legal(*cur))
-            *cur = *(--moveList);
-        else
-            ++cur;
+// count_legal_moves() returns the number of legal moves in the given position,
+// the same as MoveList<LEGAL>(pos).size() but without generating the moves.
+size_t count_legal_moves(const Position& pos) {
 
-    return moveList;
+    return pos.side_to_move() == WHITE ? count_legal<WHITE>(pos) : count_legal<BLACK>(pos);
 }
 
 }  // namespace Stockfish
@@ -21,6 +21,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
@@ -58,7 +59,7 @@ inline int pawn_structure_index(const Position& pos) {
 // be a move or even a nested history. We use a class instead of a naked value
 // to directly call history update operator<<() on the entry so to use stats
 // tables at caller sites as simple multi-dim arrays.
-template<typename T, int D>
+template<typename T, int D, bool = std::is_integral_v<T>>
 class StatsEntry {
 
     T entry;
@@ -80,6 +81,32 @@ class StatsEntry {
     }
 };
 
+// Numbers are stored as relaxed atomics, since with SharedHistory several
+// threads update the same tables. Relaxed loads and stores compile to plain
+// moves, and an update is not atomic as a whole: a concurrent one can be
+// lost, which is harmless for statistics, as for the transposition table.
+template<typename T, int D>
+class StatsEntry<T, D, true> {
+
+    std::atomic<T> entry;
+
+   public:
+    void operator=(const T& v) { entry.store(v, std::memory_order_relaxed); }
+    operator T() const { return entry.load(std::memory_order_relaxed); }
+
+    void operator<<(int bonus) {
+        static_assert(D <= std::numeric_limits<T>::max(), "D overflows T");
+
+        // Make sure that bonus is in range [-D, D]
+        int clampedBonus = std::clamp(bonus, -D, D);
+        T   e            = entry.load(std::memory_order_relaxed);
+        e += clampedBonus - e * std::abs(clampedBonus) / D;
+        entry.store(e, std::memory_order_relaxed);
+
+        assert(std::abs(e) <= D);
+    }
+};
+
 // Stats is a generic N-dimensional array used to store various statistics.
 // The first template parameter T is the base type of the array, and the second
 // template parameter D limits the range of updates in [-D, D] when we update
@@ -176,6 +203,10 @@ class MovePicker {
     MovePicker(const Position&, Move, int, const CapturePieceToHistory*);
     Move next_move(bool skipQuiets = false);
 
+    // SEE of a move in the picker's position, sharing the attackers of the
+    // target squares with the previous calls.
+    bool see_ge(Move m, int th) { return pos.see_ge(m, th, seeCache); }
+
    private:
     template<PickType T, typename Pred>
     Move select(Pred);
@@ -190,6 +221,7 @@ class MovePicker {
     const PieceToHistory**       continuationHistory;
     const PawnHistory*           pawnHistory;
     Move                         ttMove;
+    SeeCache                     seeCache;
     ExtMove refutations[3], *cur, *endMoves, *endBadCaptures, *beginBadQuiets, *endBadQuiets;
     int     stage;
     int     threshold;
@@ -19,19 +19,71 @@
 #ifndef PERFT_H_INCLUDED
 #define PERFT_H_INCLUDED
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "memory.h"
 #include "movegen.h"
 #include "position.h"
+#include "thread.h"
 #include "types.h"
 #include "uci.h"
 
 namespace Stockfish::Benchmark {
 
+// PerftTable caches the leaf counts of the subtrees already walked, keyed by
+// position and depth. It is shared by all the perft threads without locking:
+// each entry stores the key xor-ed with the count, so that a torn entry, written
+// concurrently by two threads, does not verify and is treated as a miss.
+class PerftTable {
+   public:
+    explicit PerftTable(size_t mbSize) {
+        size_t count = mbSize * 1024 * 1024 / sizeof(Entry);
+        while (count & (count - 1))  // Round down to a power of 2
+            count &= count - 1;
+
+        mask    = count - 1;
+        entries = make_unique_large_page<Entry[]>(count);
+    }
+
+    bool probe(Key key, Depth depth, uint64_t& cnt) const {
+        const Key    k = hash_key(key, depth);
+        const Entry& e = entries[k & mask];
+
+        cnt = e.count.load(std::memory_order_relaxed);
+        return (e.check.load(std::memory_order_relaxed) ^ cnt) == k;
+    }
+
+    void store(Key key, Depth depth, uint64_t cnt) {
+        const Key k = hash_key(key, depth);
+        Entry&    e = entries[k & mask];
+
+        e.check.store(k ^ cnt, std::memory_order_relaxed);
+        e.count.store(cnt, std::memory_order_relaxed);
+    }
+
+   private:
+    struct Entry {
+        std::atomic<uint64_t> check, count;
+    };
+
+    static Key hash_key(Key key, Depth depth) { return key ^ (0x9E3779B97F4A7C15ULL * depth); }
+
+    LargePagePtr<Entry[]> entries;
+    size_t                mask;
+};
+
 // Utility to verify move generation. All the leaf nodes up
 // to the given depth are generated and counted, and the sum is returned.
 template<bool Root>
-uint64_t perft(Position& pos, Depth depth) {
+uint64_t perft(Position& pos, Depth depth, PerftTable* table = nullptr) {
 
     StateInfo st;
     ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
@@ -39,6 +91,9 @@ uint64_t perft(Position& pos, Depth depth) {
     uint64_t   cnt, nodes = 0;
     const bool leaf = (depth == 2);
 
+    if (!Root && table && table->probe(pos.key(), depth, cnt))
+        return cnt;
+
     for (const auto& m : MoveList<LEGAL>(pos))
     {
         if (Root && depth <= 1)
@@ -46,22 +101,107 @@ uint64_t perft(Position& pos, Depth depth) {
         else
         {
             pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - 1);
+            cnt = leaf ? count_legal_moves(pos) : perft<false>(pos, depth - 1, table);
             nodes += cnt;
             pos.undo_move(m);
         }
         if (Root)
             sync_cout << UCIEngine::move(m, pos.is_chess960()) << ": " << cnt << sync_endl;
     }
+
+    if (!Root && table)
+        table->store(pos.key(), depth, nodes);
+
+    return nodes;
+}
+
+// Parallel perft. The subtrees after each pair of root move and reply are shared
+// out among the threads of the pool, which is fine grained enough to keep all
+// the threads busy until the end.
+inline uint64_t perft_parallel(const std::string& fen,
+                               Depth              depth,
+                               bool               isChess960,
+                               ThreadPool&        threads,
+                               size_t             threadCount,
+                               PerftTable*        table) {
+
+    StateListPtr states(new std::deque<StateInfo>(1));
+    Position     root;
+    root.set(fen, isChess960, &states->back());
+
+    // Collect the tasks, as (root move index, reply) pairs
+    std::vector<Move>                    rootMoves;
+    std::vector<std::pair<size_t, Move>> tasks;
+    StateInfo                            st;
+
+    for (const auto& m : MoveList<LEGAL>(root))
+        rootMoves.push_back(m);
+
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        root.do_move(rootMoves[i], st);
+        for (const auto& m : MoveList<LEGAL>(root))
+            tasks.emplace_back(i, m);
+        root.undo_move(rootMoves[i]);
+    }
+
+    std::vector<std::atomic<uint64_t>> counts(rootMoves.size());
+    std::atomic<size_t>                nextTask = 0;
+
+    for (size_t t = 0; t < threadCount; ++t)
+        threads.run_on_thread(t, [&]() {
+            StateListPtr threadStates(new std::deque<StateInfo>(1));
+            Position     pos;
+            StateInfo    st1, st2;
+
+            pos.set(fen, isChess960, &threadStates->back());
+
+            for (size_t idx; (idx = nextTask.fetch_add(1)) < tasks.size();)
+            {
+                const auto [i, reply] = tasks[idx];
+
+                pos.do_move(rootMoves[i], st1);
+                pos.do_move(reply, st2);
+                counts[i] += depth == 3 ? count_legal_moves(pos)
+                                        : perft<false>(pos, depth - 2, table);
+                pos.undo_move(reply);
+                pos.undo_move(rootMoves[i]);
+            }
+        });
+
+    for (size_t t = 0; t < threadCount; ++t)
+        threads.wait_on_thread(t);
+
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        nodes += counts[i];
+        sync_cout << UCIEngine::move(rootMoves[i], isChess960) << ": " << counts[i] << sync_endl;
+    }
     return nodes;
 }
 
-inline uint64_t perft(const std::string& fen, Depth depth, bool isChess960) {
+// Runs perft on the given number of threads of the pool, and with a perft hash
+// table if hashMB is not zero. The root position is split only from depth 3 on.
+inline uint64_t perft(const std::string& fen,
+                      Depth              depth,
+                      bool               isChess960,
+                      ThreadPool&        threads,
+                      size_t             threadCount = 1,
+                      size_t             hashMB      = 0) {
+
+    std::unique_ptr<PerftTable> table(hashMB ? new PerftTable(hashMB) : nullptr);
+
+    threadCount = std::clamp(threadCount, size_t(1), threads.size());
+
+    if (threadCount > 1 && depth >= 3)
+        return perft_parallel(fen, depth, isChess960, threads, threadCount, table.get());
+
     StateListPtr states(new std::deque<StateInfo>(1));
     Position     p;
     p.set(fen, isChess960, &states->back());
 
-    return perft<true>(p, depth);
+    return perft<true>(p, depth, table.get());
 }
 }
 
@@ -0,0 +1,192 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "posfile.h"
+
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "movegen.h"
+#include "uci.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#else
+    #define WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX  // Disable macros min() and max()
+    #endif
+    #include <windows.h>
+#endif
+
+namespace Stockfish {
+
+// Maps the file in memory and checks its header. The file is read sequentially
+// by the bulk commands, so tell the kernel to read ahead aggressively.
+bool PositionFile::open(const std::string& fname) {
+
+    close();
+
+    if (!is_packed(fname))
+        return false;
+
+    size_t size;
+
+#ifndef _WIN32
+    struct stat statbuf;
+    int         fd = ::open(fname.c_str(), O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    fstat(fd, &statbuf);
+    size        = statbuf.st_size;
+    mapping     = size;
+    baseAddress = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (baseAddress == MAP_FAILED)
+    {
+        std::cerr << "Could not mmap() " << fname << std::endl;
+        baseAddress = nullptr;
+        return false;
+    }
+    #if defined(MADV_SEQUENTIAL)
+    madvise(baseAddress, size, MADV_SEQUENTIAL);
+    #endif
+#else
+    HANDLE fd = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (fd == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD size_high;
+    DWORD size_low = GetFileSize(fd, &size_high);
+    size           = (uint64_t(size_high) << 32) | size_low;
+
+    HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, size_high, size_low, nullptr);
+    CloseHandle(fd);
+
+    if (!mmap)
+    {
+        std::cerr << "CreateFileMapping() failed" << std::endl;
+        return false;
+    }
+
+    mapping     = uint64_t(mmap);
+    baseAddress = MapViewOfFile(mmap, FILE_MAP_READ, 0, 0, 0);
+
+    if (!baseAddress)
+    {
+        std::cerr << "MapViewOfFile() failed, name = " << fname << ", error = " << GetLastError()
+                  << std::endl;
+        CloseHandle(mmap);
+        return false;
+    }
+#endif
+
+    fileName = fname;
+    records  = reinterpret_cast<const PackedPosition*>(static_cast<const char*>(baseAddress)
+                                                      + HeaderSize);
+    count    = (size - HeaderSize) / sizeof(PackedPosition);
+
+    return true;
+}
+
+void PositionFile::close() {
+
+    if (!baseAddress)
+        return;
+
+#ifndef _WIN32
+    munmap(baseAddress, mapping);
+#else
+    UnmapViewOfFile(baseAddress);
+    CloseHandle((HANDLE) mapping);
+#endif
+
+    fileName.clear();
+    baseAddress = nullptr;
+    records     = nullptr;
+    count       = 0;
+}
+
+bool PositionFile::is_packed(const std::string& fname) {
+
+    char          header[HeaderSize] = {};
+    std::ifstream file(fname, std::ios::binary);
+
+    return file.read(header, HeaderSize) && !std::memcmp(header, Magic, sizeof(Magic));
+}
+
+size_t PositionFile::pack(std::istream& fens, const std::string& fname, bool isChess960) {
+
+    std::ofstream file(fname, std::ios::binary);
+    char          header[HeaderSize] = {};
+    std::string   line, token;
+    size_t        written = 0;
+
+    if (!file)
+        return 0;
+
+    std::memcpy(header, Magic, sizeof(Magic));
+    file.write(header, HeaderSize);
+
+    while (std::getline(fens, line))
+    {
+        if (line.empty() || line.find("setoption") != std::string::npos)
+            continue;
+
+        StateListPtr states(new std::deque<StateInfo>(1));
+        Position     pos;
+        size_t       movesIdx = line.find(" moves ");
+
+        pos.set(line.substr(0, movesIdx), isChess960, &states->back());
+
+        if (movesIdx != std::string::npos)
+        {
+            std::istringstream is(line.substr(movesIdx + 7));
+
+            while (is >> token)
+            {
+                Move m = UCIEngine::to_move(pos, token);
+                if (m == Move::none())
+                    break;
+
+                states->emplace_back();
+                pos.do_move(m, states->back());
+            }
+        }
+
+        const PackedPosition pp = pos.to_packed();
+        file.write(reinterpret_cast<const char*>(&pp), sizeof(pp));
+        ++written;
+    }
+
+    return file ? written : 0;
+}
+
+}  // namespace Stockfish
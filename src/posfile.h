@@ -0,0 +1,81 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef POSFILE_H_INCLUDED
+#define POSFILE_H_INCLUDED
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "position.h"
+
+namespace Stockfish {
+
+// PositionFile gives read-only access to a file of PackedPosition records, memory
+// mapped so that large sets of positions can be streamed without any parsing.
+// The file starts with a 32 byte header, made of the Magic string padded with
+// zeros, and is followed by the records.
+class PositionFile {
+   public:
+    static constexpr char   Magic[]    = "SFPACKED0001";
+    static constexpr size_t HeaderSize = sizeof(PackedPosition);
+
+    PositionFile() = default;
+    ~PositionFile() { close(); }
+
+    PositionFile(const PositionFile&)            = delete;
+    PositionFile& operator=(const PositionFile&) = delete;
+
+    bool open(const std::string& fname);
+    void close();
+
+    bool               is_open() const { return baseAddress != nullptr; }
+    const std::string& name() const { return fileName; }
+    size_t             size() const { return count; }
+
+    const PackedPosition& operator[](size_t idx) const {
+        assert(idx < count);
+        return records[idx];
+    }
+
+    const PackedPosition* begin() const { return records; }
+    const PackedPosition* end() const { return records + count; }
+
+    // Tells whether the file exists and starts with a PositionFile header
+    static bool is_packed(const std::string& fname);
+
+    // Converts the FEN strings read from the stream, one per line and optionally
+    // followed by 'moves' and a list of moves, into a file of packed positions.
+    // Returns the number of positions written.
+    static size_t pack(std::istream& fens, const std::string& fname, bool isChess960);
+
+   private:
+    std::string           fileName;
+    void*                 baseAddress = nullptr;
+    uint64_t              mapping     = 0;
+    const PackedPosition* records     = nullptr;
+    size_t                count       = 0;
+};
+
+}  // namespace Stockfish
+
+#endif  // #ifndef POSFILE_H_INCLUDED
@@ -57,6 +57,137 @@ constexpr std::string_view PieceToChar(" PNBRQK  pnbrqk");
 
 constexpr Piece Pieces[] = {W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
                             B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING};
+
+constexpr int FenFieldsNb = 6;
+
+// Splits a FEN string into its whitespace separated fields, without copying
+// them. Returns the number of fields found, which may exceed FenFieldsNb.
+int split_fen(std::string_view fen, std::string_view fields[FenFieldsNb]) {
+
+    int n = 0;
+
+    for (size_t i = fen.find_first_not_of(" \t"); i != std::string_view::npos;
+         i = fen.find_first_not_of(" \t", i))
+    {
+        size_t end = std::min(fen.find_first_of(" \t", i), fen.size());
+
+        if (n < FenFieldsNb)
+            fields[n] = fen.substr(i, end - i);
+
+        ++n;
+        i = end;
+    }
+
+    return n;
+}
+
+// Parses a non-negative decimal number, returns false if the field is not one
+bool parse_number(std::string_view field, int& value) {
+
+    if (field.empty() || field.size() > 9)
+        return false;
+
+    value = 0;
+    for (char c : field)
+    {
+        if (c < '0' || c > '9')
+            return false;
+
+        value = value * 10 + (c - '0');
+    }
+
+    return true;
+}
+
+// Writes a non-negative number, returns a pointer past its last digit
+char* write_number(char* out, int value) {
+
+    char  digits[10];
+    char* p = digits;
+
+    do
+        *p++ = char('0' + value % 10);
+    while (value /= 10);
+
+    while (p != digits)
+        *out++ = *--p;
+
+    return out;
+}
+
+// Checks the pieces of a position, whatever its encoding: one king per side, at
+// most 16 pieces per side, no pawns on the first or last rank and the side not
+// to move, the opposite of 'us', not in check.
+std::string_view validate_pieces(const Bitboard byColor[], const Bitboard byType[], Color us) {
+
+    for (Color c : {WHITE, BLACK})
+    {
+        if (popcount(byColor[c] & byType[KING]) != 1)
+            return "each side must have exactly one king";
+
+        if (popcount(byColor[c]) > 16)
+            return "a side has more than 16 pieces";
+    }
+
+    if (byType[PAWN] & (Rank1BB | Rank8BB))
+        return "pawns on the first or last rank";
+
+    // The side to move must not be able to capture the king
+    const Bitboard occupied = byColor[WHITE] | byColor[BLACK];
+    const Square   ksq      = lsb(byColor[~us] & byType[KING]);
+
+    if (byColor[us]
+        & ((pawn_attacks_bb(~us, ksq) & byType[PAWN]) | (attacks_bb<KNIGHT>(ksq) & byType[KNIGHT])
+           | (attacks_bb<BISHOP>(ksq, occupied) & (byType[BISHOP] | byType[QUEEN]))
+           | (attacks_bb<ROOK>(ksq, occupied) & (byType[ROOK] | byType[QUEEN]))
+           | (attacks_bb<KING>(ksq) & byType[KING])))
+        return "the side not to move is in check";
+
+    return {};
+}
+
+// Checks the rooks holding a castling right, on top of validate_pieces(): each
+// one must be a rook on the first rank of its side, with the king there too, and
+// each side has at most one of them on either side of its king.
+std::string_view
+validate_castling(const Bitboard byColor[], const Bitboard byType[], Bitboard castlingRooks) {
+
+    int rights = 0;
+
+    while (castlingRooks)
+    {
+        const Square rsq = pop_lsb(castlingRooks);
+        const Color  c   = byColor[WHITE] & rsq ? WHITE : BLACK;
+        const Square ksq = lsb(byColor[c] & byType[KING]);
+
+        if (!(byColor[c] & byType[ROOK] & rsq) || rank_of(rsq) != relative_rank(c, RANK_1))
+            return "castling rook not on the first rank";
+
+        if (rank_of(ksq) != relative_rank(c, RANK_1))
+            return "castling rights without the king on its first rank";
+
+        CastlingRights cr = c & (ksq < rsq ? KING_SIDE : QUEEN_SIDE);
+
+        if (rights & cr)
+            return "duplicate castling rights";
+
+        rights |= cr;
+    }
+
+    return {};
+}
+
+// Clears a state before setting up a position. The NNUE accumulators, the bulk
+// of StateInfo, are left as they are and only marked as not computed.
+void clear_state(StateInfo* si) {
+
+    std::memset(static_cast<void*>(si), 0, offsetof(StateInfo, accumulatorBig));
+
+    si->accumulatorBig.computed[WHITE]   = si->accumulatorBig.computed[BLACK]   = false;
+    si->accumulatorSmall.computed[WHITE] = si->accumulatorSmall.computed[BLACK] = false;
+    si->dirtyPiece                       = {};
+}
+
 }  // namespace
 
 
@@ -155,10 +286,11 @@ void Position::init() {
 }
 
 
-// Initializes the position object with the given FEN string.
-// This function is not very robust - make sure that input FENs are correct,
-// this is assumed to be the responsibility of the GUI.
-Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
+// Initializes the position object with the given FEN string. The string is
+// parsed in place, without any allocation. This function is not very robust -
+// make sure that input FENs are correct, e.g. with validate_fen(), this is
+// assumed to be the responsibility of the GUI.
+Position& Position::set(std::string_view fenStr, bool isChess960, StateInfo* si) {
     /*
    A FEN string defines a particular position using only the ASCII character set.
 
@@ -194,19 +326,18 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
       incremented after Black's move.
 */
 
-    unsigned char      col, row, token;
-    size_t             idx;
-    Square             sq = SQ_A8;
-    std::istringstream ss(fenStr);
+    std::string_view fields[FenFieldsNb];
+    Square           sq = SQ_A8;
+    size_t           idx;
+
+    split_fen(fenStr, fields);
 
     std::memset(this, 0, sizeof(Position));
-    std::memset(si, 0, sizeof(StateInfo));
+    clear_state(si);
     st = si;
 
-    ss >> std::noskipws;
-
     // 1. Piece placement
-    while ((ss >> token) && !isspace(token))
+    for (char token : fields[0])
     {
         if (isdigit(token))
             sq += (token - '0') * EAST;  // Advance the given number of files
@@ -222,16 +353,14 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
     }
 
     // 2. Active color
-    ss >> token;
-    sideToMove = (token == 'w' ? WHITE : BLACK);
-    ss >> token;
+    sideToMove = (!fields[1].empty() && fields[1][0] == 'w' ? WHITE : BLACK);
 
     // 3. Castling availability. Compatible with 3 standards: Normal FEN standard,
     // Shredder-FEN that uses the letters of the columns on which the rooks began
     // the game instead of KQkq and also X-FEN standard that, in case of Chess960,
     // if an inner rook is associated with the castling right, the castling tag is
     // replaced by the file letter of the involved rook, as for the Shredder-FEN.
-    while ((ss >> token) && !isspace(token))
+    for (char token : fields[2])
     {
         Square rsq;
         Color  c    = islower(token) ? BLACK : WHITE;
@@ -258,27 +387,21 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
 
     // 4. En passant square.
     // Ignore if square is invalid or not on side to move relative rank 6.
-    bool enpassant = false;
+    const std::string_view ep        = fields[3];
+    bool                   enpassant = false;
 
-    if (((ss >> col) && (col >= 'a' && col <= 'h'))
-        && ((ss >> row) && (row == (sideToMove == WHITE ? '6' : '3'))))
+    if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && ep[1] == (sideToMove == WHITE ? '6' : '3'))
     {
-        st->epSquare = make_square(File(col - 'a'), Rank(row - '1'));
-
-        // En passant square will be considered only if
-        // a) side to move have a pawn threatening epSquare
-        // b) there is an enemy pawn in front of epSquare
-        // c) there is no piece on epSquare or behind epSquare
-        enpassant = pawn_attacks_bb(~sideToMove, st->epSquare) & pieces(sideToMove, PAWN)
-                 && (pieces(~sideToMove, PAWN) & (st->epSquare + pawn_push(~sideToMove)))
-                 && !(pieces() & (st->epSquare | (st->epSquare + pawn_push(sideToMove))));
+        st->epSquare = make_square(File(ep[0] - 'a'), Rank(ep[1] - '1'));
+        enpassant    = ep_square_is_valid(st->epSquare);
     }
 
     if (!enpassant)
         st->epSquare = SQ_NONE;
 
     // 5-6. Halfmove clock and fullmove number
-    ss >> std::skipws >> st->rule50 >> gamePly;
+    parse_number(fields[4], st->rule50);
+    parse_number(fields[5], gamePly);
 
     // Convert from fullmove starting from 1 to gamePly starting from 0,
     // handle also common incorrect FEN with fullmove = 0.
@@ -293,6 +416,257 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
 }
 
 
+// Checks that a FEN string describes a position that set() can handle: well
+// formed fields, one king per side, no pawns on the first or last rank, rooks
+// for all the castling rights, an en passant square right behind a pawn which
+// has just been pushed, and the side not to move not in check. Returns an
+// empty string if the FEN is valid, or else a description of the first error.
+std::string_view Position::validate_fen(std::string_view fen) {
+
+    std::string_view fields[FenFieldsNb];
+    Bitboard         byColor[COLOR_NB] = {}, byType[PIECE_TYPE_NB] = {};
+    int              n = split_fen(fen, fields), rank = RANK_8, file = FILE_A;
+    size_t           idx;
+
+    if (n < 4)
+        return "missing fields";
+
+    if (n > FenFieldsNb)
+        return "unexpected characters after the fullmove number";
+
+    // 1. Piece placement
+    for (char token : fields[0])
+    {
+        if (token == '/')
+        {
+            if (file != FILE_NB || rank-- == RANK_1)
+                return "the piece placement must have 8 ranks of 8 squares";
+            file = FILE_A;
+        }
+        else if (token >= '1' && token <= '8')
+            file += token - '0';
+
+        else if (token != ' ' && (idx = PieceToChar.find(token)) != string::npos)
+        {
+            if (file >= FILE_NB)
+                return "the piece placement must have 8 ranks of 8 squares";
+
+            Square s = make_square(File(file++), Rank(rank));
+            byColor[color_of(Piece(idx))] |= s;
+            byType[type_of(Piece(idx))] |= s;
+        }
+        else
+            return "invalid character in the piece placement";
+
+        if (file > FILE_NB)
+            return "the piece placement must have 8 ranks of 8 squares";
+    }
+
+    if (rank != RANK_1 || file != FILE_NB)
+        return "the piece placement must have 8 ranks of 8 squares";
+
+    // 2. Active color
+    if (fields[1] != "w" && fields[1] != "b")
+        return "the side to move must be 'w' or 'b'";
+
+    const Color    us       = fields[1] == "w" ? WHITE : BLACK;
+    const Bitboard occupied = byColor[WHITE] | byColor[BLACK];
+
+    if (std::string_view err = validate_pieces(byColor, byType, us); !err.empty())
+        return err;
+
+    // 3. Castling availability, the rooks are looked for on the first rank even
+    // when the king is not there, validate_castling() reports that case.
+    if (fields[2] != "-")
+    {
+        Bitboard castlingRooks = 0;
+
+        for (char token : fields[2])
+        {
+            Color    c     = islower(token) ? BLACK : WHITE;
+            Square   ksq   = make_square(file_of(lsb(byColor[c] & byType[KING])),
+                                         relative_rank(c, RANK_1));
+            Bitboard rooks = byColor[c] & byType[ROOK] & rank_bb(relative_rank(c, RANK_1));
+            Square   rsq   = SQ_NONE;
+
+            token = char(toupper(token));
+
+            if (token == 'K' && (rooks & ~(square_bb(ksq) - 1) & ~square_bb(ksq)))
+                rsq = msb(rooks);
+
+            else if (token == 'Q' && (rooks & (square_bb(ksq) - 1)))
+                rsq = lsb(rooks);
+
+            else if (token >= 'A' && token <= 'H')
+            {
+                rsq = make_square(File(token - 'A'), relative_rank(c, RANK_1));
+                if (!(rooks & rsq))
+                    rsq = SQ_NONE;
+            }
+            else if (token != 'K' && token != 'Q')
+                return "invalid castling rights";
+
+            if (rsq == SQ_NONE)
+                return "castling rights without a rook to castle with";
+
+            if (castlingRooks & rsq)
+                return "duplicate castling rights";
+
+            castlingRooks |= rsq;
+        }
+
+        if (std::string_view err = validate_castling(byColor, byType, castlingRooks); !err.empty())
+            return err;
+    }
+
+    // 4. En passant square, the pushed pawn must be in front of it
+    if (fields[3] != "-")
+    {
+        const std::string_view ep = fields[3];
+
+        if (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || ep[1] != (us == WHITE ? '6' : '3'))
+            return "invalid en passant square";
+
+        Square epSquare = make_square(File(ep[0] - 'a'), Rank(ep[1] - '1'));
+
+        if (!(byColor[~us] & byType[PAWN] & (epSquare + pawn_push(~us)))
+            || (occupied & (epSquare | (epSquare + pawn_push(us)))))
+            return "no pawn can have just been pushed past the en passant square";
+    }
+
+    // 5-6. Halfmove clock and fullmove number
+    int number;
+
+    if (n > 4 && !parse_number(fields[4], number))
+        return "the halfmove clock must be a number";
+
+    if (n > 5 && !parse_number(fields[5], number))
+        return "the fullmove number must be a number";
+
+    return {};
+}
+
+
+// Checks a packed position, such as a record read from a file, before it is
+// passed to set_from_packed(), that does not check anything. Returns an empty
+// string if the position is valid, otherwise the reason why it is not.
+std::string_view Position::validate_packed(const PackedPosition& pp) {
+
+    Bitboard occupied = 0, castlingRooks = 0, byColor[COLOR_NB] = {}, byType[PIECE_TYPE_NB] = {};
+
+    for (int i = 0; i < 8; ++i)
+        occupied |= Bitboard(pp.occupied[i]) << (8 * i);
+
+    if (popcount(occupied) > 32)
+        return "more than 32 pieces";
+
+    for (int i = 0; occupied; ++i)
+    {
+        Square s    = pop_lsb(occupied);
+        int    code = (pp.pieces[i / 2] >> (4 * (i & 1))) & 0xF;
+
+        if ((code & 7) == 0)
+            return "invalid piece code";
+
+        if ((code & 7) == 7)
+            castlingRooks |= s;
+
+        byColor[code >> 3] |= s;
+        byType[(code & 7) == 7 ? ROOK : type_of(Piece(code))] |= s;
+    }
+
+    if (std::string_view err = validate_pieces(byColor, byType, Color(pp.sideToMove & 1));
+        !err.empty())
+        return err;
+
+    return validate_castling(byColor, byType, castlingRooks);
+}
+
+
+// Initializes the position object from its binary encoding, see PackedPosition.
+// Like set(), this trusts the input to describe a legal position.
+Position& Position::set_from_packed(const PackedPosition& pp, bool isChess960, StateInfo* si) {
+
+    std::memset(this, 0, sizeof(Position));
+    clear_state(si);
+    st = si;
+
+    Bitboard occupied = 0, castlingRooks = 0;
+
+    for (int i = 0; i < 8; ++i)
+        occupied |= Bitboard(pp.occupied[i]) << (8 * i);
+
+    for (int i = 0; occupied; ++i)
+    {
+        Square s    = pop_lsb(occupied);
+        int    code = (pp.pieces[i / 2] >> (4 * (i & 1))) & 0xF;
+
+        if ((code & 7) == 7)  // Rook with a castling right
+        {
+            code = make_piece(Color(code >> 3), ROOK);
+            castlingRooks |= s;
+        }
+
+        put_piece(Piece(code), s);
+    }
+
+    // The castling rights need both kings on the board
+    while (castlingRooks)
+    {
+        Square rsq = pop_lsb(castlingRooks);
+        set_castling_right(color_of(piece_on(rsq)), rsq);
+    }
+
+    sideToMove   = Color(pp.sideToMove & 1);
+    st->epSquare = Square(pp.epSquare);
+
+    if (!is_ok(st->epSquare) || relative_rank(sideToMove, st->epSquare) != RANK_6
+        || !ep_square_is_valid(st->epSquare))
+        st->epSquare = SQ_NONE;
+
+    st->rule50 = pp.rule50;
+    gamePly    = pp.gamePly[0] | (pp.gamePly[1] << 8);
+    chess960   = isChess960;
+    set_state();
+
+    assert(pos_is_ok());
+
+    return *this;
+}
+
+
+// Returns the binary encoding of the position, see PackedPosition
+PackedPosition Position::to_packed() const {
+
+    PackedPosition pp{};
+    Bitboard       occupied = pieces();
+
+    assert(popcount(occupied) <= 32);
+
+    for (int i = 0; i < 8; ++i)
+        pp.occupied[i] = uint8_t(occupied >> (8 * i));
+
+    for (int i = 0; occupied; ++i)
+    {
+        Square s    = pop_lsb(occupied);
+        int    code = piece_on(s);
+
+        if (type_of(piece_on(s)) == ROOK && (castlingRightsMask[s] & st->castlingRights))
+            code |= 7;
+
+        pp.pieces[i / 2] |= uint8_t(code << (4 * (i & 1)));
+    }
+
+    pp.sideToMove = uint8_t(sideToMove);
+    pp.epSquare   = uint8_t(st->epSquare);
+    pp.rule50     = uint8_t(std::min(st->rule50, 255));
+    pp.gamePly[0] = uint8_t(gamePly);
+    pp.gamePly[1] = uint8_t(gamePly >> 8);
+
+    return pp;
+}
+
+
 // Helper function used to set castling
 // rights given the corresponding color and the rook starting square.
 void Position::set_castling_right(Color c, Square rfrom) {
@@ -312,6 +686,19 @@ void Position::set_castling_right(Color c, Square rfrom) {
 }
 
 
+// Tells whether a given en passant square, on the sixth rank relative to the
+// side to move, should be considered. That is when
+// a) side to move have a pawn threatening epSquare
+// b) there is an enemy pawn in front of epSquare
+// c) there is no piece on epSquare or behind epSquare
+bool Position::ep_square_is_valid(Square epSquare) const {
+
+    return pawn_attacks_bb(~sideToMove, epSquare) & pieces(sideToMove, PAWN)
+        && (pieces(~sideToMove, PAWN) & (epSquare + pawn_push(~sideToMove)))
+        && !(pieces() & (epSquare | (epSquare + pawn_push(sideToMove))));
+}
+
+
 // Sets king attacks to detect if a move gives check
 void Position::set_check_info() const {
 
@@ -326,6 +713,7 @@ void Position::set_check_info() const {
     st->checkSquares[ROOK]   = attacks_bb<ROOK>(ksq, pieces());
     st->checkSquares[QUEEN]  = st->checkSquares[BISHOP] | st->checkSquares[ROOK];
     st->checkSquares[KING]   = 0;
+    st->checkInfoSet         = true;
 }
 
 
@@ -393,48 +781,70 @@ Position& Position::set(const string& code, Color c, StateInfo* si) {
 // Chess960 the Shredder-FEN notation is used. This is mainly a debugging function.
 string Position::fen() const {
 
-    int                emptyCnt;
-    std::ostringstream ss;
+    char buffer[MaxFenLength];
+    return string(buffer, fen(buffer));
+}
+
+
+// Writes the FEN of the position to the given buffer, which must hold at least
+// MaxFenLength characters, without any allocation. Returns a pointer past the
+// last character written. The string is not null terminated.
+char* Position::fen(char* out) const {
 
     for (Rank r = RANK_8; r >= RANK_1; --r)
     {
         for (File f = FILE_A; f <= FILE_H; ++f)
         {
+            int emptyCnt;
+
             for (emptyCnt = 0; f <= FILE_H && empty(make_square(f, r)); ++f)
                 ++emptyCnt;
 
             if (emptyCnt)
-                ss << emptyCnt;
+                *out++ = char('0' + emptyCnt);
 
             if (f <= FILE_H)
-                ss << PieceToChar[piece_on(make_square(f, r))];
+                *out++ = PieceToChar[piece_on(make_square(f, r))];
         }
 
         if (r > RANK_1)
-            ss << '/';
+            *out++ = '/';
     }
 
-    ss << (sideToMove == WHITE ? " w " : " b ");
+    *out++ = ' ';
+    *out++ = sideToMove == WHITE ? 'w' : 'b';
+    *out++ = ' ';
 
     if (can_castle(WHITE_OO))
-        ss << (chess960 ? char('A' + file_of(castling_rook_square(WHITE_OO))) : 'K');
+        *out++ = chess960 ? char('A' + file_of(castling_rook_square(WHITE_OO))) : 'K';
 
     if (can_castle(WHITE_OOO))
-        ss << (chess960 ? char('A' + file_of(castling_rook_square(WHITE_OOO))) : 'Q');
+        *out++ = chess960 ? char('A' + file_of(castling_rook_square(WHITE_OOO))) : 'Q';
 
     if (can_castle(BLACK_OO))
-        ss << (chess960 ? char('a' + file_of(castling_rook_square(BLACK_OO))) : 'k');
+        *out++ = chess960 ? char('a' + file_of(castling_rook_square(BLACK_OO))) : 'k';
 
     if (can_castle(BLACK_OOO))
-        ss << (chess960 ? char('a' + file_of(castling_rook_square(BLACK_OOO))) : 'q');
+        *out++ = chess960 ? char('a' + file_of(castling_rook_square(BLACK_OOO))) : 'q';
 
     if (!can_castle(ANY_CASTLING))
-        ss << '-';
+        *out++ = '-';
+
+    *out++ = ' ';
 
-    ss << (ep_square() == SQ_NONE ? " - " : " " + UCIEngine::square(ep_square()) + " ")
-       << st->rule50 << " " << 1 + (gamePly - (sideToMove == BLACK)) / 2;
+    if (ep_square() == SQ_NONE)
+        *out++ = '-';
+    else
+    {
+        *out++ = char('a' + file_of(ep_square()));
+        *out++ = char('1' + rank_of(ep_square()));
+    }
 
-    return ss.str();
+    *out++ = ' ';
+    out    = write_number(out, st->rule50);
+    *out++ = ' ';
+
+    return write_number(out, 1 + (gamePly - (sideToMove == BLACK)) / 2);
 }
 
 // Calculates st->blockersForKing[c] and st->pinners[~c],
@@ -832,8 +1242,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
     sideToMove = ~sideToMove;
 
-    // Update king attacks used for fast check detection
-    set_check_info();
+    // King attacks used for fast check detection are computed on first use
+    st->checkInfoSet = false;
 
     // Calculate the repetition info. It is the ply distance from the previous
     // occurrence of the same position, negative in the 3-fold case, or zero
@@ -984,7 +1394,7 @@ void Position::do_null_move(StateInfo& newSt, TranspositionTable& tt) {
 
     sideToMove = ~sideToMove;
 
-    set_check_info();
+    st->checkInfoSet = false;
 
     st->repetition = 0;
 
@@ -1025,7 +1435,8 @@ Key Position::key_after(Move m) const {
 // Tests if the SEE (Static Exchange Evaluation)
 // value of move is greater or equal to the given threshold. We'll use an
 // algorithm similar to alpha-beta pruning with a null window.
-bool Position::see_ge(Move m, int threshold) const {
+template<typename AttackersTo>
+bool Position::see_ge(Move m, int threshold, AttackersTo attackers_to_target) const {
 
     assert(m.is_ok());
 
@@ -1046,7 +1457,7 @@ bool Position::see_ge(Move m, int threshold) const {
     assert(color_of(piece_on(from)) == sideToMove);
     Bitboard occupied  = pieces() ^ from ^ to;  // xoring to is important for pinned piece logic
     Color    stm       = sideToMove;
-    Bitboard attackers = attackers_to(to, occupied);
+    Bitboard attackers = attackers_to_target(from, to, occupied);
     Bitboard stmAttackers, bb;
     int      res = 1;
 
@@ -1126,11 +1537,61 @@ bool Position::see_ge(Move m, int threshold) const {
     return bool(res);
 }
 
+bool Position::see_ge(Move m, int threshold) const {
+
+    return see_ge(m, threshold, [&](Square, Square to, Bitboard occupied) {
+        return attackers_to(to, occupied);
+    });
+}
+
+// As above, but sharing the attackers of the target square with the other moves
+// to the same square. The attackers to 'to' with 'from' removed from the board
+// are the cached attackers on the full board, plus the sliders that 'from' was
+// hiding, which a single slider lookup along the line through 'from' finds.
+bool Position::see_ge(Move m, int threshold, SeeCache& cache) const {
+
+    return see_ge(m, threshold, [&](Square from, Square to, Bitboard occupied) {
+        // The first move to a square computes its attackers directly, and only
+        // a second one fills the cache, so that the moves to distinct squares,
+        // the majority of the quiets, do not pay for the x-ray lookups.
+        if (!(cache.known & to))
+        {
+            if (!(cache.seen & to))
+            {
+                cache.seen |= to;
+                return attackers_to(to, occupied);
+            }
+
+            cache.attackers[to] = attackers_to(to);
+            cache.known |= to;
+        }
+
+        Bitboard attackers = cache.attackers[to];
+
+        if (attacks_bb<BISHOP>(to) & from)
+            attackers |= attacks_bb<BISHOP>(to, occupied) & pieces(BISHOP, QUEEN);
+        else if (attacks_bb<ROOK>(to) & from)
+            attackers |= attacks_bb<ROOK>(to, occupied) & pieces(ROOK, QUEEN);
+
+        return attackers;
+    });
+}
+
+// Batch version of see_ge(), evaluating the given moves against their own
+// thresholds in the same position, and sharing the attackers between them.
+void Position::see_ge(const Move* moves, const int* thresholds, bool* results, size_t count) const {
+
+    SeeCache cache;
+
+    for (size_t i = 0; i < count; ++i)
+        results[i] = see_ge(moves[i], thresholds[i], cache);
+}
+
 // Tests whether the position is drawn by 50-move rule
 // or by repetition. It does not detect stalemates.
 bool Position::is_draw(int ply) const {
 
-    if (st->rule50 > 99 && (!checkers() || MoveList<LEGAL>(*this).size()))
+    if (st->rule50 > 99 && (!checkers() || count_legal_moves(*this)))
         return true;
 
     // Return a draw score if a position repeats once earlier but strictly
@@ -20,10 +20,13 @@
 #define POSITION_H_INCLUDED
 
 #include <cassert>
+#include <cstdint>
 #include <deque>
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "bitboard.h"
 #include "nnue/nnue_accumulator.h"
@@ -56,6 +59,7 @@ struct StateInfo {
     Bitboard   blockersForKing[COLOR_NB];
     Bitboard   pinners[COLOR_NB];
     Bitboard   checkSquares[PIECE_TYPE_NB];
+    bool       checkInfoSet;  // The three above are computed on first use
     Piece      capturedPiece;
     int        repetition;
 
@@ -73,6 +77,77 @@ struct StateInfo {
 using StateListPtr = std::unique_ptr<std::deque<StateInfo>>;
 
 
+// StateArena is the reusable counterpart of StateListPtr, for the game history
+// kept by the engine across 'position' commands. The states live in chunks of
+// cache-aligned StateInfo objects that are kept by reset(), so that setting up a
+// new position reuses the memory of the previous one instead of reallocating it.
+// As with the deque, pointers to the states stay valid when the arena grows.
+class StateArena {
+   public:
+    StateArena() { reset(); }
+
+    // Drops all the states and returns the first one, for the root of the game
+    StateInfo& reset() {
+        count = 0;
+        return emplace_back();
+    }
+
+    StateInfo& emplace_back() {
+        if (count == chunks.size() * ChunkSize)
+            // Default-initialized, the states are set when they are used
+            chunks.emplace_back(new StateInfo[ChunkSize]);
+
+        ++count;
+        return back();
+    }
+
+    StateInfo&       back() { return chunks[(count - 1) / ChunkSize][(count - 1) % ChunkSize]; }
+    const StateInfo& back() const {
+        return chunks[(count - 1) / ChunkSize][(count - 1) % ChunkSize];
+    }
+    size_t size() const { return count; }
+
+   private:
+    static constexpr size_t ChunkSize = 64;
+
+    static_assert(alignof(StateInfo) >= Eval::NNUE::CacheLineSize,
+                  "StateInfo should be aligned to a cache line");
+
+    std::vector<std::unique_ptr<StateInfo[]>> chunks;
+    size_t                                    count;
+};
+
+
+// PackedPosition is a compact binary encoding of a position, 32 bytes long,
+// used to store large sets of positions (see PositionFile). The bitboard of the
+// occupied squares is followed by one 4-bit piece code per occupied square, in
+// square order. Rooks that still hold a castling right use the otherwise unused
+// codes 7 (white) and 15 (black), so no castling field is needed, also for
+// Chess960. Multi-byte fields are stored in little endian order.
+struct PackedPosition {
+    uint8_t occupied[8];
+    uint8_t pieces[16];  // Two pieces per byte, low nibble first
+    uint8_t sideToMove;
+    uint8_t epSquare;  // SQ_NONE if there is no en passant square
+    uint8_t rule50;
+    uint8_t gamePly[2];
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
+
+// SeeCache holds the attackers of the target squares already examined by
+// Position::see_ge() in a given position, so that all the moves to the same
+// square share them. It must be cleared when the position changes.
+struct SeeCache {
+    void clear() { seen = known = 0; }
+
+    Bitboard seen = 0, known = 0;
+    Bitboard attackers[SQUARE_NB];
+};
+
+
 // Position class stores information regarding the board representation as
 // pieces, side to move, hash keys, castling info, etc. Important methods are
 // do_move() and undo_move(), used by the search to update node info when
@@ -86,9 +161,19 @@ class Position {
     Position& operator=(const Position&) = delete;
 
     // FEN string input/output
-    Position&   set(const std::string& fenStr, bool isChess960, StateInfo* si);
+    static constexpr size_t MaxFenLength = 128;
+
+    static std::string_view validate_fen(std::string_view fen);
+    static std::string_view validate_packed(const PackedPosition& pp);
+
+    Position&   set(std::string_view fenStr, bool isChess960, StateInfo* si);
     Position&   set(const std::string& code, Color c, StateInfo* si);
     std::string fen() const;
+    char*       fen(char* out) const;
+
+    // Binary input/output
+    Position&      set_from_packed(const PackedPosition& pp, bool isChess960, StateInfo* si);
+    PackedPosition to_packed() const;
 
     // Position representation
     Bitboard pieces(PieceType pt = ALL_PIECES) const;
@@ -118,6 +203,7 @@ class Position {
     Bitboard blockers_for_king(Color c) const;
     Bitboard check_squares(PieceType pt) const;
     Bitboard pinners(Color c) const;
+    bool     check_info_set() const;
 
     // Attacks to/from a given square
     Bitboard attackers_to(Square s) const;
@@ -144,9 +230,12 @@ class Position {
 
     // Static Exchange Evaluation
     bool see_ge(Move m, int threshold = 0) const;
+    bool see_ge(Move m, int threshold, SeeCache& cache) const;
+    void see_ge(const Move* moves, const int* thresholds, bool* results, size_t count) const;
 
     // Accessing hash keys
     Key key() const;
+    Key raw_key() const;
     Key key_after(Move m) const;
     Key material_key() const;
     Key pawn_key() const;
@@ -175,10 +264,14 @@ class Position {
    private:
     // Initialization helpers (used while setting up a position)
     void set_castling_right(Color c, Square rfrom);
+    bool ep_square_is_valid(Square epSquare) const;
     void set_state() const;
     void set_check_info() const;
+    void ensure_check_info() const;
 
     // Other helpers
+    template<typename AttackersTo>
+    bool see_ge(Move m, int threshold, AttackersTo attackers_to_target) const;
     void move_piece(Square from, Square to);
     template<bool Do>
     void do_castling(Color us, Square from, Square& to, Square& rfrom, Square& rto);
@@ -280,14 +373,36 @@ inline Bitboard Position::attacks_by(Color c) const {
 
 inline Bitboard Position::checkers() const { return st->checkersBB; }
 
-inline Bitboard Position::blockers_for_king(Color c) const { return st->blockersForKing[c]; }
+// The check info is not needed by the many nodes that are cut off before
+// generating or testing any move, so do_move() leaves it to the first use.
+inline void Position::ensure_check_info() const {
+    if (!st->checkInfoSet)
+        set_check_info();
+}
+
+inline bool Position::check_info_set() const { return st->checkInfoSet; }
+
+inline Bitboard Position::blockers_for_king(Color c) const {
+    ensure_check_info();
+    return st->blockersForKing[c];
+}
 
-inline Bitboard Position::pinners(Color c) const { return st->pinners[c]; }
+inline Bitboard Position::pinners(Color c) const {
+    ensure_check_info();
+    return st->pinners[c];
+}
 
-inline Bitboard Position::check_squares(PieceType pt) const { return st->checkSquares[pt]; }
+inline Bitboard Position::check_squares(PieceType pt) const {
+    ensure_check_info();
+    return st->checkSquares[pt];
+}
 
 inline Key Position::key() const { return adjust_key50<false>(st->key); }
 
+// The key without the 50-move rule adjustment of key(), for the data that do
+// not depend on the 50-move counter, like the tablebase WDL scores.
+inline Key Position::raw_key() const { return st->key; }
+
 template<bool AfterMove>
 inline Key Position::adjust_key50(Key k) const {
     return st->rule50 < 14 - AfterMove ? k : k ^ make_key((st->rule50 - (14 - AfterMove)) / 8);
@@ -26,6 +26,9 @@
 #include <cstdint>
 #include <cstdlib>
 #include <initializer_list>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <utility>
 
@@ -73,7 +76,7 @@ constexpr int futility_move_count(bool improving, Depth depth) {
 
 // Add correctionHistory value to raw staticEval and guarantee evaluation does not hit the tablebase range
 Value to_corrected_static_eval(Value v, const Worker& w, const Position& pos) {
-    auto cv = w.correctionHistory[pos.side_to_move()][pawn_structure_index<Correction>(pos)];
+    const int cv = w.correctionHistory[pos.side_to_move()][pawn_structure_index<Correction>(pos)];
     v += cv / 10;
     return std::clamp(v, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
 }
@@ -138,7 +141,15 @@ void update_all_stats(const Position& pos,
 Search::Worker::Worker(SharedState&                    sharedState,
                        std::unique_ptr<ISearchManager> sm,
                        size_t                          threadId,
-                       NumaReplicatedAccessToken       token) :
+                       NumaReplicatedAccessToken       token,
+                       Histories*                      sharedHistories,
+                       bool                            clearSharedHistories) :
+    ownHistories(sharedHistories ? nullptr : make_unique_large_page<Histories>()),
+    histories(sharedHistories ? *sharedHistories : *ownHistories),
+    clearHistories(!sharedHistories || clearSharedHistories),
+    mainHistory(histories.mainHistory),
+    captureHistory(histories.captureHistory),
+    continuationHistory(histories.continuationHistory),
     // Unpack the SharedState struct into member variables
     threadIdx(threadId),
     numaAccessToken(token),
@@ -157,6 +168,9 @@ void Search::Worker::start_searching() {
     if (!is_mainthread())
     {
         iterative_deepening();
+
+        if (threads.deterministic)
+            threads.leave_rounds();
         return;
     }
 
@@ -174,6 +188,9 @@ void Search::Worker::start_searching() {
     {
         threads.start_searching();  // start non-main threads
         iterative_deepening();      // main thread start searching
+
+        if (threads.deterministic)
+            threads.leave_rounds(!main_manager()->ponder && !limits.infinite);
     }
 
     // When we reach the maximum depth, we can arrive here without a raise of
@@ -184,6 +201,10 @@ void Search::Worker::start_searching() {
     while (!threads.stop && (main_manager()->ponder || limits.infinite))
     {}  // Busy wait for a stop or a ponder reset
 
+    // In deterministic mode the stop can only be raised between two rounds
+    if (threads.deterministic)
+        threads.stop_after_round();
+
     // Stop the threads if not already stopped (also raise the stop if
     // "ponderhit" just reset threads.ponder).
     threads.stop = true;
@@ -191,6 +212,13 @@ void Search::Worker::start_searching() {
     // Wait until all threads have finished
     threads.wait_for_search_finished();
 
+    {
+        std::scoped_lock<std::mutex> lk(threads.searchStatsMutex);
+
+        for (auto&& th : threads)
+            threads.searchStats += th->worker->stats;
+    }
+
     // When playing in 'nodes as time' mode, subtract the searched nodes from
     // the available ones before exiting.
     if (limits.npmsec)
@@ -208,8 +236,9 @@ void Search::Worker::start_searching() {
     main_manager()->bestPreviousScore        = bestThread->rootMoves[0].score;
     main_manager()->bestPreviousAverageScore = bestThread->rootMoves[0].averageScore;
 
-    // Send again PV info if we have a new best thread
-    if (bestThread != this)
+    // Send again PV info if we have a new best thread. In deterministic mode
+    // always do it, as the last info was sent while other threads were searching.
+    if (bestThread != this || threads.deterministic)
         main_manager()->pv(*bestThread, threads, tt, bestThread->completedDepth);
 
     std::string ponder;
@@ -388,7 +417,9 @@ void Search::Worker::iterative_deepening() {
                 // that cannot be trusted, i.e. it can be delayed or refuted if we would have
                 // had time to fully search other root-moves. Thus we suppress this output and
                 // below pick a proven score/PV for this thread (from the previous iteration).
-                && !(threads.abortedSearch && rootMoves[0].uciScore <= VALUE_TB_LOSS_IN_MAX_PLY))
+                && !(threads.abortedSearch && rootMoves[0].uciScore <= VALUE_TB_LOSS_IN_MAX_PLY)
+                // In deterministic mode the PV is anyhow sent again once all threads are done
+                && !(threads.deterministic && threads.stop))
                 main_manager()->pv(*this, threads, tt, rootDepth);
         }
 
@@ -496,18 +527,25 @@ void Search::Worker::iterative_deepening() {
                              skill.best ? skill.best : skill.pick_best(rootMoves, multiPV)));
 }
 
-void Search::Worker::clear() {
-    counterMoves.fill(Move::none());
+void Search::Histories::clear() {
     mainHistory.fill(0);
     captureHistory.fill(0);
-    pawnHistory.fill(-1193);
-    correctionHistory.fill(0);
 
     for (bool inCheck : {false, true})
         for (StatsType c : {NoCaptures, Captures})
             for (auto& to : continuationHistory[inCheck][c])
                 for (auto& h : to)
                     h->fill(-56);
+}
+
+void Search::Worker::clear() {
+    counterMoves.fill(Move::none());
+    pawnHistory.fill(-1193);
+    correctionHistory.fill(0);
+
+    // Shared histories are cleared only once, by the first Worker using them
+    if (clearHistories)
+        histories.clear();
 
     for (size_t i = 1; i < reductions.size(); ++i)
         reductions[i] = int((19.26 + std::log(size_t(options["Threads"])) / 2) * std::log(i));
@@ -516,6 +554,67 @@ void Search::Worker::clear() {
 }
 
 
+// Formats the statistics as a table with one row per depth, followed by the totals
+std::string Search::SearchStats::to_string() const {
+
+#ifndef USE_SEARCH_STATS
+    return "Search statistics are not available, build with searchstats=yes to collect them";
+#else
+    std::stringstream ss;
+    uint64_t          total[COUNTER_NB] = {};
+
+    auto pct = [](uint64_t part, uint64_t whole) {
+        std::stringstream s;
+        if (whole)
+            s << std::fixed << std::setprecision(1) << 100.0 * part / whole;
+        else
+            s << "-";
+        return s.str();
+    };
+
+    auto row = [&](const uint64_t* c) {
+        const uint64_t nodes = c[PvNodes] + c[CutNodes] + c[AllNodes];
+        ss << std::setw(12) << c[PvNodes] << std::setw(12) << c[CutNodes] << std::setw(12)
+           << c[AllNodes] << std::setw(8) << pct(c[TtHits], nodes) << std::setw(8)
+           << pct(c[TtCutoffs], nodes) << std::setw(8) << pct(c[FirstMoveCutoffs], c[Cutoffs])
+           << std::setw(8) << pct(c[NullMoveCutoffs], c[NullMoveTries]) << std::setw(8)
+           << pct(c[ProbCutCutoffs], c[ProbCutTries]) << std::setw(8)
+           << pct(c[LmrResearches], c[LmrSearches]) << "\n";
+    };
+
+    ss << "Search statistics, rates in %\n"
+       << "depth          PV         cut         all   TThit   TTcut  1stcut     NMP ProbCut  LMRres\n";
+
+    for (int d = 1; d < MaxDepth; ++d)
+    {
+        const uint64_t* c = counts[d];
+        for (int i = 0; i < COUNTER_NB; ++i)
+            total[i] += c[i];
+
+        if (c[PvNodes] + c[CutNodes] + c[AllNodes])
+        {
+            ss << std::setw(5) << d;
+            row(c);
+        }
+    }
+
+    ss << "total";
+    row(total);
+
+    const uint64_t qnodes = counts[0][QsearchNodes];
+    ss << "qsearch nodes " << qnodes << " ("
+       << pct(qnodes, qnodes + total[PvNodes] + total[CutNodes] + total[AllNodes])
+       << "% of all), TT hits " << pct(counts[0][TtHits], qnodes) << "%, TT cutoffs "
+       << pct(counts[0][TtCutoffs], qnodes) << "%\n"
+       << "check info skipped in " << pct(total[CheckInfoSkipped], total[MovesMade])
+       << "% of the children, " << pct(counts[0][CheckInfoSkipped], counts[0][MovesMade])
+       << "% in qsearch";
+
+    return ss.str();
+#endif
+}
+
+
 // Main search function for both PV and non-PV nodes.
 template<NodeType nodeType>
 Value Search::Worker::search(
@@ -557,18 +656,29 @@ Value Search::Worker::search(
     Bound singularBound;
 
     // Step 1. Initialize node
-    Worker* thisThread = this;
-    ss->inCheck        = pos.checkers();
-    priorCapture       = pos.captured_piece();
+    Worker*     thisThread = this;
+    const Depth statsDepth = depth;
+    ss->inCheck            = pos.checkers();
+    priorCapture           = pos.captured_piece();
     Color us           = pos.side_to_move();
     moveCount = captureCount = quietCount = ss->moveCount = 0;
     bestValue                                             = -VALUE_INFINITE;
     maxValue                                              = VALUE_INFINITE;
 
+    stats.inc(PvNode    ? SearchStats::PvNodes
+              : cutNode ? SearchStats::CutNodes
+                        : SearchStats::AllNodes,
+              statsDepth);
+
     // Check for the available remaining time
     if (is_mainthread())
         main_manager()->check_time(*thisThread);
 
+    // In deterministic mode wait for the other threads at the end of the round
+    if (threads.deterministic && (nodes >= roundEnd || ttBuffer.full())
+        && !threads.stop.load(std::memory_order_relaxed))
+        threads.wait_for_round_end();
+
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && thisThread->selDepth < ss->ply + 1)
         thisThread->selDepth = ss->ply + 1;
@@ -606,7 +716,8 @@ Value Search::Worker::search(
     // Step 4. Transposition table lookup.
     excludedMove                   = ss->excludedMove;
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] =
+      threads.deterministic ? ttBuffer.probe(tt, posKey) : tt.probe(posKey);
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = rootNode ? thisThread->rootMoves[thisThread->pvIdx].pv[0]
@@ -616,6 +727,9 @@ Value Search::Worker::search(
     ss->ttPv     = excludedMove ? ss->ttPv : PvNode || (ttHit && ttData.is_pv);
     ttCapture    = ttData.move && pos.capture_stage(ttData.move);
 
+    if (ttHit)
+        stats.inc(SearchStats::TtHits, statsDepth);
+
     // At this point, if excluded, skip straight to step 6, static eval. However,
     // to save indentation, we list the condition in all code between here and there.
 
@@ -641,7 +755,10 @@ Value Search::Worker::search(
         // Partial workaround for the graph history interaction problem
         // For high rule50 counts don't produce transposition table cutoffs.
         if (pos.rule50_count() < 90)
+        {
+            stats.inc(SearchStats::TtCutoffs, statsDepth);
             return ttData.value;
+        }
     }
 
     // Step 5. Tablebases probe
@@ -790,6 +907,8 @@ Value Search::Worker::search(
     {
         assert(eval - beta >= 0);
 
+        stats.inc(SearchStats::NullMoveTries, statsDepth);
+
         // Null move dynamic reduction based on depth and eval
         Depth R = std::min(int(eval - beta) / 197, 6) + depth / 3 + 5;
 
@@ -806,7 +925,10 @@ Value Search::Worker::search(
         if (nullValue >= beta && nullValue < VALUE_TB_WIN_IN_MAX_PLY)
         {
             if (thisThread->nmpMinPly || depth < 16)
+            {
+                stats.inc(SearchStats::NullMoveCutoffs, statsDepth);
                 return nullValue;
+            }
 
             assert(!thisThread->nmpMinPly);  // Recursive verification is not allowed
 
@@ -819,7 +941,10 @@ Value Search::Worker::search(
             thisThread->nmpMinPly = 0;
 
             if (v >= beta)
+            {
+                stats.inc(SearchStats::NullMoveCutoffs, statsDepth);
                 return nullValue;
+            }
         }
     }
 
@@ -852,6 +977,8 @@ Value Search::Worker::search(
     {
         assert(probCutBeta < VALUE_INFINITE && probCutBeta > beta);
 
+        stats.inc(SearchStats::ProbCutTries, statsDepth);
+
         MovePicker mp(pos, ttData.move, probCutBeta - ss->staticEval, &thisThread->captureHistory);
 
         while ((move = mp.next_move()) != Move::none())
@@ -882,6 +1009,8 @@ Value Search::Worker::search(
 
                 if (value >= probCutBeta)
                 {
+                    stats.inc(SearchStats::ProbCutCutoffs, statsDepth);
+
                     // Save ProbCut data into transposition table
                     ttWriter.write(posKey, value_to_tt(value, ss->ply), ss->ttPv, BOUND_LOWER,
                                    depth - 3, move, unadjustedStaticEval, tt.generation());
@@ -921,9 +1050,15 @@ moves_loop:  // When in check, search starts here
     singularValue    = VALUE_INFINITE;
     singularBound    = BOUND_NONE;
 
+    // Moves postponed in ABDADA mode because another thread is searching them
+    Move       deferredMoves[32];
+    int        deferredCount = 0, deferredIdx = 0;
+    const bool deferMoves    = !rootNode && threads.deferMoves;
+
     // Step 13. Loop through all pseudo-legal moves until no moves remain
-    // or a beta cutoff occurs.
-    while ((move = mp.next_move(moveCountPruning)) != Move::none())
+    // or a beta cutoff occurs. Deferred moves, if any, are searched last.
+    while ((move = mp.next_move(moveCountPruning)) != Move::none()
+           || (deferredIdx < deferredCount && (move = deferredMoves[deferredIdx++])))
     {
         assert(move.is_ok());
 
@@ -942,6 +1077,17 @@ moves_loop:  // When in check, search starts here
                            thisThread->rootMoves.begin() + thisThread->pvLast, move))
             continue;
 
+        // ABDADA move deferral. If a sibling thread is already searching the
+        // resulting position, try the other moves first. The first move is never
+        // deferred, and neither are the moves of the second pass.
+        if (deferMoves && moveCount && !deferredIdx && deferredCount < 32
+            && depth >= CurrentlySearching::DeferDepth
+            && threads.currentlySearching.contains(pos.key_after(move)))
+        {
+            deferredMoves[deferredCount++] = move;
+            continue;
+        }
+
         ss->moveCount = ++moveCount;
 
         if (rootNode && is_mainthread() && elapsed_time() > 3000)
@@ -993,7 +1139,7 @@ moves_loop:  // When in check, search starts here
 
                 // SEE based pruning for captures and checks (~11 Elo)
                 int seeHist = std::clamp(captHist / 32, -180 * depth, 163 * depth);
-                if (!pos.see_ge(move, -160 * depth - seeHist))
+                if (!mp.see_ge(move, -160 * depth - seeHist))
                     continue;
             }
             else
@@ -1026,7 +1172,7 @@ moves_loop:  // When in check, search starts here
                 lmrDepth = std::max(lmrDepth, 0);
 
                 // Prune moves with negative SEE (~4 Elo)
-                if (!pos.see_ge(move, -24 * lmrDepth * lmrDepth))
+                if (!mp.see_ge(move, -24 * lmrDepth * lmrDepth))
                     continue;
             }
         }
@@ -1117,6 +1263,11 @@ moves_loop:  // When in check, search starts here
 
         uint64_t nodeCount = rootNode ? uint64_t(nodes) : 0;
 
+        // Publish the child node for ABDADA, it is withdrawn after the search
+        const bool published = deferMoves && depth >= CurrentlySearching::DeferDepth;
+        if (published)
+            threads.currentlySearching.insert(pos.key_after(move));
+
         // Step 16. Make the move
         thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
         pos.do_move(move, st, givesCheck);
@@ -1173,9 +1324,13 @@ moves_loop:  // When in check, search starts here
 
             value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, d, true);
 
+            stats.inc(SearchStats::LmrSearches, statsDepth);
+
             // Do a full-depth search when reduced LMR search fails high
             if (value > alpha && d < newDepth)
             {
+                stats.inc(SearchStats::LmrResearches, statsDepth);
+
                 // Adjust full-depth search based on LMR results - if the result
                 // was good enough search deeper, if it was bad enough search shallower.
                 const bool doDeeperSearch    = value > (bestValue + 35 + 2 * newDepth);  // (~1 Elo)
@@ -1216,9 +1371,16 @@ moves_loop:  // When in check, search starts here
             value = -search<PV>(pos, ss + 1, -beta, -alpha, newDepth, false);
         }
 
+        stats.inc(SearchStats::MovesMade, statsDepth);
+        if (!pos.check_info_set())
+            stats.inc(SearchStats::CheckInfoSkipped, statsDepth);
+
         // Step 19. Undo move
         pos.undo_move(move);
 
+        if (published)
+            threads.currentlySearching.remove(pos.key_after(move));
+
         assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
         // Step 20. Check for a new best move
@@ -1289,6 +1451,10 @@ moves_loop:  // When in check, search starts here
 
                 if (value >= beta)
                 {
+                    stats.inc(SearchStats::Cutoffs, statsDepth);
+                    if (moveCount == 1)
+                        stats.inc(SearchStats::FirstMoveCutoffs, statsDepth);
+
                     ss->cutoffCnt += 1 + !ttData.move - (extension >= 2);
                     assert(value >= beta);  // Fail high
                     break;
@@ -1321,7 +1487,7 @@ moves_loop:  // When in check, search starts here
     // must be a mate or a stalemate. If we are in a singular extension search then
     // return a fail low score.
 
-    assert(moveCount || !ss->inCheck || excludedMove || !MoveList<LEGAL>(pos).size());
+    assert(moveCount || !ss->inCheck || excludedMove || !count_legal_moves(pos));
 
     // Adjust best value for fail high cases at non-pv nodes
     if (!PvNode && bestValue >= beta && std::abs(bestValue) < VALUE_TB_WIN_IN_MAX_PLY
@@ -1435,6 +1601,8 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     ss->inCheck        = pos.checkers();
     moveCount          = 0;
 
+    stats.inc(SearchStats::QsearchNodes, 0);
+
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && thisThread->selDepth < ss->ply + 1)
         thisThread->selDepth = ss->ply + 1;
@@ -1454,18 +1622,25 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
 
     // Step 3. Transposition table lookup
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] =
+      threads.deterministic ? ttBuffer.probe(tt, posKey) : tt.probe(posKey);
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = ttHit ? ttData.move : Move::none();
     ttData.value = ttHit ? value_from_tt(ttData.value, ss->ply, pos.rule50_count()) : VALUE_NONE;
     pvHit        = ttHit && ttData.is_pv;
 
+    if (ttHit)
+        stats.inc(SearchStats::TtHits, 0);
+
     // At non-PV nodes we check for an early TT cutoff
     if (!PvNode && ttData.depth >= qsTtDepth
         && ttData.value != VALUE_NONE  // Can happen when !ttHit or when access race in probe()
         && (ttData.bound & (ttData.value >= beta ? BOUND_LOWER : BOUND_UPPER)))
+    {
+        stats.inc(SearchStats::TtCutoffs, 0);
         return ttData.value;
+    }
 
     // Step 4. Static evaluation of the position
     Value unadjustedStaticEval = VALUE_NONE;
@@ -1565,7 +1740,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
 
                 // If static eval is much lower than alpha and move is not winning material
                 // we can prune this move. (~2 Elo)
-                if (futilityBase <= alpha && !pos.see_ge(move, 1))
+                if (futilityBase <= alpha && !mp.see_ge(move, 1))
                 {
                     bestValue = std::max(bestValue, futilityBase);
                     continue;
@@ -1573,7 +1748,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
 
                 // If static exchange evaluation is much worse than what is needed to not
                 // fall below alpha we can prune this move.
-                if (futilityBase > alpha && !pos.see_ge(move, (alpha - futilityBase) * 2 - 30))
+                if (futilityBase > alpha && !mp.see_ge(move, (alpha - futilityBase) * 2 - 30))
                 {
                     bestValue = alpha;
                     continue;
@@ -1590,7 +1765,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
                 continue;
 
             // Do not search moves with bad enough SEE values (~5 Elo)
-            if (!pos.see_ge(move, -74))
+            if (!mp.see_ge(move, -74))
                 continue;
         }
 
@@ -1607,6 +1782,11 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
         thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
         pos.do_move(move, st, givesCheck);
         value = -qsearch<nodeType>(pos, ss + 1, -beta, -alpha, depth - 1);
+
+        stats.inc(SearchStats::MovesMade, 0);
+        if (!pos.check_info_set())
+            stats.inc(SearchStats::CheckInfoSkipped, 0);
+
         pos.undo_move(move);
 
         assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
@@ -1636,7 +1816,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     // and no legal moves were found, it is checkmate.
     if (ss->inCheck && bestValue == -VALUE_INFINITE)
     {
-        assert(!MoveList<LEGAL>(pos).size());
+        assert(!count_legal_moves(pos));
         return mated_in(ss->ply);  // Plies to mate from the root
     }
 
@@ -1911,7 +2091,8 @@ void SearchManager::check_time(Search::Worker& worker) {
       worker.completedDepth >= 1
       && ((worker.limits.use_time_management() && (elapsed > tm.maximum() || stopOnPonderhit))
           || (worker.limits.movetime && elapsed >= worker.limits.movetime)
-          || (worker.limits.nodes && worker.threads.nodes_searched() >= worker.limits.nodes)))
+          || (worker.limits.nodes && !worker.threads.deterministic
+              && worker.threads.nodes_searched() >= worker.limits.nodes)))
         worker.threads.stop = worker.threads.abortedSearch = true;
 }
 
@@ -1920,7 +2101,9 @@ void SearchManager::pv(const Search::Worker&     worker,
                        const TranspositionTable& tt,
                        Depth                     depth) const {
 
-    const auto  nodes     = threads.nodes_searched();
+    const auto  nodes     = threads.deterministic && !threads.stop
+                            ? threads.round_nodes_searched(worker)
+                            : threads.nodes_searched();
     const auto& rootMoves = worker.rootMoves;
     const auto& pos       = worker.rootPos;
     size_t      pvIdx     = worker.pvIdx;
@@ -19,6 +19,7 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
@@ -30,6 +31,7 @@
 #include <string_view>
 #include <vector>
 
+#include "memory.h"
 #include "misc.h"
 #include "movepick.h"
 #include "nnue/network.h"
@@ -39,6 +41,7 @@
 #include "score.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
+#include "tt.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -50,7 +53,6 @@ enum NodeType {
     Root
 };
 
-class TranspositionTable;
 class ThreadPool;
 class OptionsMap;
 
@@ -113,8 +115,8 @@ struct LimitsType {
     LimitsType() {
         time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
         movestogo = depth = mate = perft = infinite = 0;
-        nodes                                       = 0;
-        ponderMode                                  = false;
+        nodes = perftThreads = perftHash = 0;
+        ponderMode                       = false;
     }
 
     bool use_time_management() const { return time[WHITE] || time[BLACK]; }
@@ -123,6 +125,7 @@ struct LimitsType {
     TimePoint                time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
     int                      movestogo, depth, mate, perft, infinite;
     uint64_t                 nodes;
+    size_t                   perftThreads, perftHash;  // Only used by perft, hash in MB
     bool                     ponderMode;
     Square                   capSq;
 };
@@ -229,12 +232,81 @@ class NullSearchManager: public ISearchManager {
 };
 
 
+// Histories holds the history tables that can be shared among threads. They
+// belong to a single Worker, unless the SharedHistory option is set: then all the
+// Workers bound to the same NUMA node use one copy, updated without any locking
+// in the same spirit as the transposition table.
+struct Histories {
+    void clear();
+
+    ButterflyHistory      mainHistory;
+    CapturePieceToHistory captureHistory;
+    ContinuationHistory   continuationHistory[2][2];
+};
+
+
+// SearchStats counts, per remaining depth, where the nodes of the search go and
+// how often the pruning and reduction techniques succeed. The counters are only
+// collected in builds with searchstats=yes (which defines USE_SEARCH_STATS),
+// otherwise they do not exist and updating them is a no-op.
+struct SearchStats {
+
+    // Deeper nodes are counted at MaxDepth - 1, qsearch nodes at depth 0
+    static constexpr int MaxDepth = 64;
+
+    enum Counter {
+        PvNodes,
+        CutNodes,
+        AllNodes,
+        QsearchNodes,
+        TtHits,
+        TtCutoffs,
+        Cutoffs,
+        FirstMoveCutoffs,
+        NullMoveTries,
+        NullMoveCutoffs,
+        ProbCutTries,
+        ProbCutCutoffs,
+        LmrSearches,
+        LmrResearches,
+        MovesMade,
+        CheckInfoSkipped,
+        COUNTER_NB
+    };
+
+#ifdef USE_SEARCH_STATS
+    void inc(Counter c, Depth d) { ++counts[std::clamp(d, 0, MaxDepth - 1)][c]; }
+    void clear() { *this = SearchStats(); }
+
+    SearchStats& operator+=(const SearchStats& other) {
+        for (int d = 0; d < MaxDepth; ++d)
+            for (int c = 0; c < COUNTER_NB; ++c)
+                counts[d][c] += other.counts[d][c];
+        return *this;
+    }
+
+    uint64_t counts[MaxDepth][COUNTER_NB] = {};
+#else
+    void         inc(Counter, Depth) {}
+    void         clear() {}
+    SearchStats& operator+=(const SearchStats&) { return *this; }
+#endif
+
+    std::string to_string() const;
+};
+
+
 // Search::Worker is the class that does the actual search.
 // It is instantiated once per thread, and it is responsible for keeping track
 // of the search history, and storing data required for the search.
 class Worker {
    public:
-    Worker(SharedState&, std::unique_ptr<ISearchManager>, size_t, NumaReplicatedAccessToken);
+    Worker(SharedState&,
+           std::unique_ptr<ISearchManager>,
+           size_t,
+           NumaReplicatedAccessToken,
+           Histories* sharedHistories,
+           bool       clearSharedHistories);
 
     // Called at instantiation to initialize Reductions tables
     // Reset histories, usually before a new game
@@ -248,12 +320,19 @@ class Worker {
 
     // Public because they need to be updatable by the stats
     CounterMoveHistory    counterMoves;
-    ButterflyHistory      mainHistory;
-    CapturePieceToHistory captureHistory;
-    ContinuationHistory   continuationHistory[2][2];
     PawnHistory           pawnHistory;
     CorrectionHistory     correctionHistory;
 
+   private:
+    LargePagePtr<Histories> ownHistories;  // Null when using shared ones
+    Histories&              histories;
+    bool                    clearHistories;
+
+   public:
+    ButterflyHistory&      mainHistory;
+    CapturePieceToHistory& captureHistory;
+    ContinuationHistory (&continuationHistory)[2][2];
+
    private:
     void iterative_deepening();
 
@@ -302,6 +381,13 @@ class Worker {
 
     Tablebases::Config tbConfig;
 
+    // Merged into ThreadPool::searchStats once the search is finished
+    SearchStats stats;
+
+    // Used in deterministic SMP mode, see ThreadPool::wait_for_round_end()
+    TTRoundBuffer ttBuffer;
+    uint64_t      roundEnd;
+
     const OptionsMap&                           options;
     ThreadPool&                                 threads;
     TranspositionTable&                         tt;
@@ -21,30 +21,39 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <deque>
 #include <fstream>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <numeric>
 #include <sstream>
 #include <string_view>
 #include <sys/stat.h>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "../bitboard.h"
+#include "../memory.h"
 #include "../misc.h"
 #include "../movegen.h"
 #include "../position.h"
 #include "../search.h"
+#include "../thread.h"
 #include "../types.h"
 #include "../ucioption.h"
 
 #ifndef _WIN32
+    #include <dirent.h>
     #include <fcntl.h>
     #include <sys/mman.h>
     #include <unistd.h>
@@ -199,15 +208,23 @@ class TBFile: public std::ifstream {
     //
     // Example:
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
-    static std::string Paths;
+    static std::string Paths, IndexFile;
+
+    // After scan(), the full path of every tablebase file found in Paths, so
+    // that a file is looked up here instead of trying to open it everywhere.
+    static bool                                         Scanned;
+    static std::unordered_map<std::string, std::string> Found;
 
     TBFile(const std::string& f) {
 
-#ifndef _WIN32
-        constexpr char SepChar = ':';
-#else
-        constexpr char SepChar = ';';
-#endif
+        if (Scanned)
+        {
+            auto it = Found.find(f);
+            if (it != Found.end())
+                std::ifstream::open(fname = it->second);
+            return;
+        }
+
         std::stringstream ss(Paths);
         std::string       path;
 
@@ -220,8 +237,109 @@ class TBFile: public std::ifstream {
         }
     }
 
+    static bool exists(const std::string& f) {
+        return Scanned ? Found.count(f) : TBFile(f).is_open();
+    }
+
+#ifndef _WIN32
+    static constexpr char SepChar = ':';
+#else
+    static constexpr char SepChar = ';';
+#endif
+
+    // Lists the .rtbw and .rtbz files of the Paths directories, reading each
+    // directory once. The first directory holding a file wins, as when opening
+    // it. With an index file, the list is read from there instead, as long as
+    // it was written for the same paths and none of the directories changed
+    // since, and written there otherwise.
+    static void scan(const std::string& indexFile) {
+
+        std::vector<std::pair<std::string, int64_t>> dirs;  // Path and last change
+        std::stringstream                            ss(Paths);
+        std::string                                  path, line;
+
+        Found.clear();
+        Scanned = false;
+
+        while (std::getline(ss, path, SepChar))
+        {
+            struct stat statbuf;
+            if (stat(path.c_str(), &statbuf))
+                return;  // Leave it to the open attempts to cope with this path
+
+            dirs.emplace_back(path, int64_t(statbuf.st_mtime));
+        }
+
+        std::ifstream index(indexFile);
+        if (!indexFile.empty() && std::getline(index, line) && line == index_header(dirs))
+        {
+            std::string name;
+            while (index >> name && std::getline(index >> std::ws, path))
+                Found.emplace(name, path);
+
+            Scanned = true;
+            return;
+        }
+
+        for (const auto& dir : dirs)
+            for (const std::string& name : list_directory(dir.first))
+                if (name.size() > 5
+                    && (name.compare(name.size() - 5, 5, ".rtbw") == 0
+                        || name.compare(name.size() - 5, 5, ".rtbz") == 0))
+                    Found.emplace(name, dir.first + "/" + name);  // No-op if already found
+
+        Scanned = true;
+
+        if (!indexFile.empty())
+        {
+            std::ofstream out(indexFile);
+            out << index_header(dirs) << "\n";
+
+            for (const auto& [name, fullPath] : Found)
+                out << name << " " << fullPath << "\n";
+        }
+    }
+
+   private:
+    static std::string index_header(const std::vector<std::pair<std::string, int64_t>>& dirs) {
+        std::string header = "SFTBINDEX1";
+        for (const auto& [dir, mtime] : dirs)
+            header += " " + std::to_string(mtime) + " " + dir;
+        return header;
+    }
+
+    static std::vector<std::string> list_directory(const std::string& dir) {
+
+        std::vector<std::string> names;
+
+#ifndef _WIN32
+        if (DIR* d = opendir(dir.c_str()))
+        {
+            while (const dirent* entry = readdir(d))
+                names.emplace_back(entry->d_name);
+
+            closedir(d);
+        }
+#else
+        WIN32_FIND_DATAA data;
+        HANDLE           h = FindFirstFileA((dir + "\\*").c_str(), &data);
+
+        if (h != INVALID_HANDLE_VALUE)
+        {
+            do
+                names.emplace_back(data.cFileName);
+            while (FindNextFileA(h, &data));
+
+            FindClose(h);
+        }
+#endif
+        return names;
+    }
+
+   public:
+
     // Memory map the file and check it.
-    uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type) {
+    uint8_t* map(void** baseAddress, uint64_t* mapping, uint64_t* size, TBType type) {
         if (is_open())
             close();  // Need to re-open to get native file descriptor
 
@@ -240,8 +358,8 @@ class TBFile: public std::ifstream {
             exit(EXIT_FAILURE);
         }
 
-        *mapping     = statbuf.st_size;
-        *baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        *mapping = *size = statbuf.st_size;
+        *baseAddress     = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
     #if defined(MADV_RANDOM)
         madvise(*baseAddress, statbuf.st_size, MADV_RANDOM);
     #endif
@@ -279,6 +397,7 @@ class TBFile: public std::ifstream {
         }
 
         *mapping     = uint64_t(mmap);
+        *size        = (uint64_t(size_high) << 32) | size_low;
         *baseAddress = MapViewOfFile(mmap, FILE_MAP_READ, 0, 0, 0);
 
         if (!*baseAddress)
@@ -309,11 +428,177 @@ class TBFile: public std::ifstream {
 #else
         UnmapViewOfFile(baseAddress);
         CloseHandle((HANDLE) mapping);
+#endif
+    }
+
+    // Reads a mapped file into memory ahead of its use, optionally locking it
+    // there. Returns the number of bytes that end up resident, when the system
+    // can tell, or else the number of bytes read.
+    static uint64_t preload(void* baseAddress, uint64_t size, bool lock, uint64_t* locked) {
+
+        constexpr uint64_t PageSize = 4096;
+
+        const volatile uint8_t* data = (uint8_t*) baseAddress;
+        uint8_t                 sum  = 0;
+
+#ifndef _WIN32
+    #if defined(MADV_WILLNEED)
+        madvise(baseAddress, size, MADV_WILLNEED);
+    #endif
+        if (lock && !mlock(baseAddress, size))
+            *locked += size;
+#else
+        if (lock && VirtualLock(baseAddress, size))
+            *locked += size;
+#endif
+
+        // Touch every page, in file order, so that the reads are sequential
+        for (uint64_t i = 0; i < size; i += PageSize)
+            sum += data[i];
+
+        (void) sum;
+
+#if defined(__linux__)
+        std::vector<unsigned char> pages((size + PageSize - 1) / PageSize);
+        uint64_t                   resident = 0;
+
+        if (mincore(baseAddress, size, pages.data()))
+            return size;
+
+        for (unsigned char p : pages)
+            resident += (p & 1) * PageSize;
+
+        return std::min(resident, size);
+#else
+        return size;
+#endif
+    }
+
+    // Releases the pages locked by preload()
+    static void unlock(void* baseAddress, uint64_t size) {
+#ifndef _WIN32
+        munlock(baseAddress, size);
+#else
+        VirtualUnlock(baseAddress, size);
 #endif
     }
 };
 
-std::string TBFile::Paths;
+std::string                                  TBFile::Paths, TBFile::IndexFile;
+bool                                         TBFile::Scanned;
+std::unordered_map<std::string, std::string> TBFile::Found;
+
+// BlockCache keeps the last few blocks of a DTZ table that have been probed,
+// already Huffman decoded into their sequence of symbols, together with the
+// offset just past the last value of each symbol. A repeated probe into one of
+// these blocks finds its symbol with a binary search instead of decoding the
+// block bit by bit. Blocks are evicted in LRU order. DTZ probes are rare
+// compared to WDL ones, so a plain mutex is enough for the concurrent accesses.
+struct BlockCache {
+
+    static constexpr int Size = 4;
+
+    struct Entry {
+        uint32_t              block = UINT32_MAX;
+        uint64_t              lastUse = 0;
+        std::vector<Sym>      syms;
+        std::vector<uint16_t> ends;  // Values of a block are at most 65536
+
+        // Returns the symbol holding the value at the given offset of the block,
+        // and the offset of the value within it.
+        Sym symbol(int* offset) const {
+            size_t i = std::lower_bound(ends.begin(), ends.end(), *offset) - ends.begin();
+
+            if (i)
+                *offset -= ends[i - 1] + 1;
+
+            return syms[i];
+        }
+    };
+
+    std::mutex mutex;
+    uint64_t   clock = 0;
+    Entry      entries[Size];
+};
+
+// Cleared by dtz_bench() only, to compare with plain decoding
+std::atomic<bool> UseBlockCache{true};
+
+// Probe statistics, see Tablebases::stats(). They are collected only when
+// enabled, since timing every probe and updating counters shared by all the
+// threads is not free.
+std::atomic<bool> CollectStats{false};
+
+// Latencies of the probe_wdl() and probe_dtz() calls: bucket i counts the calls
+// that took from 2^i to 2^(i+1) nanoseconds.
+struct LatencyHistogram {
+
+    static constexpr int Buckets = 32;
+
+    std::atomic<uint64_t> counts[Buckets];
+
+    void clear() {
+        for (auto& c : counts)
+            c = 0;
+    }
+
+    void add(std::chrono::steady_clock::duration d) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        counts[ns ? std::min(int(msb(ns)), Buckets - 1) : 0].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (const auto& c : counts)
+            sum += c.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Upper bound of the bucket holding the given fraction of the calls
+    uint64_t percentile(double p) const {
+        uint64_t sum = 0, target = uint64_t(p * total());
+        for (int i = 0; i < Buckets; ++i)
+            if ((sum += counts[i].load(std::memory_order_relaxed)) > target)
+                return uint64_t(2) << i;
+        return 0;
+    }
+
+    std::string to_string(const char* name) const {
+        std::ostringstream ss;
+        ss << name << " latency: " << total() << " calls, p50 < " << percentile(0.5)
+           << " ns, p90 < " << percentile(0.9) << " ns, p99 < " << percentile(0.99) << " ns\n";
+
+        ss << name << " histogram:";
+        for (int i = 0; i < Buckets; ++i)
+            if (uint64_t n = counts[i].load(std::memory_order_relaxed))
+                ss << " " << (uint64_t(1) << i) << "ns:" << n;
+        return ss.str();
+    }
+};
+
+LatencyHistogram      WDLLatency, DTZLatency;
+std::atomic<uint64_t> MissingTableProbes;
+
+// Memory budget of the mapped tables, in bytes, 0 for no limit. Beyond it the
+// least recently probed tables are unmapped, see evict(). MapEpoch counts the
+// mappings and serves as the clock of the LRU order.
+uint64_t              MemoryLimit = 0;
+std::atomic<uint64_t> MappedBytes, MapEpoch, Unmapped;
+
+// The probes in progress of a table are counted on several cache lines, each
+// thread using its own one, so that threads probing the same table do not
+// write to a shared line. Threads beyond ReaderStripes share the lines.
+constexpr size_t    ReaderStripes = 8;
+std::atomic<size_t> NextReaderStripe;
+
+struct alignas(64) ReaderCount {
+    std::atomic<uint32_t> count{0};
+};
+
+size_t reader_stripe() {
+    thread_local const size_t stripe = NextReaderStripe++ % ReaderStripes;
+    return stripe;
+}
 
 // struct PairsData contains low-level indexing information to access TB data.
 // There are 8, 4, or 2 PairsData records for each TBTable, according to the type
@@ -340,6 +625,8 @@ struct PairsData {
     uint64_t groupIdx[TBPIECES + 1];  // Start index used for the encoding of the group's pieces
     int      groupLen[TBPIECES + 1];  // Number of pieces in a given group: KRKN -> (3, 1)
     uint16_t map_idx[4];              // WDLWin, WDLLoss, WDLCursedWin, WDLBlessedLoss (used in DTZ)
+    std::unique_ptr<BlockCache> blockCache;  // Only for DTZ tables
+    std::atomic<uint64_t>*      decodes;     // Counter of the table, see TBTable
 };
 
 // struct TBTable contains indexing information to access the corresponding TBFile.
@@ -353,9 +640,11 @@ struct TBTable {
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
     std::atomic_bool ready;
+    std::mutex       mutex;  // Serializes the first access to this table only
     void*            baseAddress;
     uint8_t*         map;
     uint64_t         mapping;
+    uint64_t         fileSize;
     Key              key;
     Key              key2;
     int              pieceCount;
@@ -364,6 +653,18 @@ struct TBTable {
     uint8_t          pawnCount[2];     // [Lead color / other color]
     PairsData        items[Sides][4];  // [wtm / btm][FILE_A..FILE_D or 0]
 
+    // Statistics: probes of the table, how many of them found the file mapped
+    // and blocks decompressed, if CollectStats, and the first access time.
+    std::atomic<uint64_t> probes{0}, hits{0}, decodes{0};
+    uint64_t              mapTime = 0;  // Microseconds
+
+    // With a memory limit, the probes in progress and the mapping epoch of the
+    // last probe, see evict(). Preloaded tables are never unmapped.
+    ReaderCount           readers[ReaderStripes];
+    std::atomic<uint64_t> lastUse{0};
+    std::atomic_bool      preloaded{false};
+    bool                  locked = false;  // Set by preload(), with no search running
+
     PairsData* get(int stm, int f) { return &items[stm % Sides][hasPawns ? f : 0]; }
 
     TBTable() :
@@ -425,76 +726,92 @@ TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) :
 // at init time, accessed at probe time.
 class TBTables {
 
-    struct Entry {
-        Key           key;
-        TBTable<WDL>* wdl;
-        TBTable<DTZ>* dtz;
-
-        template<TBType Type>
-        TBTable<Type>* get() const {
-            return (TBTable<Type>*) (Type == WDL ? (void*) wdl : (void*) dtz);
-        }
-    };
-
-    static constexpr int Size     = 1 << 12;  // 4K table, indexed by key's 12 lsb
-    static constexpr int Overflow = 1;  // Number of elements allowed to map to the last bucket
+    // The hash table has at least this many buckets per key, so that with
+    // Robin Hood hashing the probe sequences stay within a few buckets.
+    static constexpr size_t BucketsPerKey = 2;
 
-    Entry hashTable[Size + Overflow];
+    // The hash table is split in the array of the keys, the only one scanned by
+    // the lookups, and the arrays of the table pointers, read once the key is
+    // found. A zero key marks an empty bucket, the material key of a table is
+    // never zero since there are always the kings.
+    std::vector<Key>           keys;
+    std::vector<TBTable<WDL>*> wdlTables;
+    std::vector<TBTable<DTZ>*> dtzTables;
+    size_t                     mask;
 
     std::deque<TBTable<WDL>> wdlTable;
     std::deque<TBTable<DTZ>> dtzTable;
+    std::vector<std::string> codes;  // Like "KRvK", in the order of wdlTable
 
     void insert(Key key, TBTable<WDL>* wdl, TBTable<DTZ>* dtz) {
-        uint32_t homeBucket = uint32_t(key) & (Size - 1);
-        Entry    entry{key, wdl, dtz};
 
-        // Ensure last element is empty to avoid overflow when looking up
-        for (uint32_t bucket = homeBucket; bucket < Size + Overflow - 1; ++bucket)
+        assert(key);
+
+        for (size_t bucket = key & mask, distance = 0;; bucket = (bucket + 1) & mask, ++distance)
         {
-            Key otherKey = hashTable[bucket].key;
-            if (otherKey == key || !hashTable[bucket].get<WDL>())
+            if (!keys[bucket] || keys[bucket] == key)
             {
-                hashTable[bucket] = entry;
+                keys[bucket]      = key;
+                wdlTables[bucket] = wdl;
+                dtzTables[bucket] = dtz;
                 return;
             }
 
             // Robin Hood hashing: If we've probed for longer than this element,
             // insert here and search for a new spot for the other element instead.
-            uint32_t otherHomeBucket = uint32_t(otherKey) & (Size - 1);
-            if (otherHomeBucket > homeBucket)
+            size_t otherDistance = (bucket - keys[bucket]) & mask;
+            if (otherDistance < distance)
             {
-                std::swap(entry, hashTable[bucket]);
-                key        = otherKey;
-                homeBucket = otherHomeBucket;
+                std::swap(key, keys[bucket]);
+                std::swap(wdl, wdlTables[bucket]);
+                std::swap(dtz, dtzTables[bucket]);
+                distance = otherDistance;
             }
         }
-        std::cerr << "TB hash table size too low!" << std::endl;
-        exit(EXIT_FAILURE);
     }
 
    public:
+    TBTables() { clear(); }
+
     template<TBType Type>
     TBTable<Type>* get(Key key) {
-        for (const Entry* entry = &hashTable[uint32_t(key) & (Size - 1)];; ++entry)
-        {
-            if (entry->key == key || !entry->get<Type>())
-                return entry->get<Type>();
-        }
+        for (size_t bucket = key & mask;; bucket = (bucket + 1) & mask)
+            if (keys[bucket] == key || !keys[bucket])
+            {
+                if constexpr (Type == WDL)
+                    return wdlTables[bucket];
+                else
+                    return dtzTables[bucket];
+            }
     }
 
     void clear() {
-        memset(hashTable, 0, sizeof(hashTable));
+        keys.assign(1, 0);  // A single empty bucket, lookups find nothing
+        wdlTables.assign(1, nullptr);
+        dtzTables.assign(1, nullptr);
+        mask = 0;
         wdlTable.clear();
         dtzTable.clear();
+        codes.clear();
     }
-    size_t size() const { return wdlTable.size(); }
+    size_t                          size() const { return wdlTable.size(); }
+    const std::vector<std::string>& material_codes() const { return codes; }
     void   add(const std::vector<PieceType>& pieces);
+    void   build();
+
+    template<typename F>
+    void for_each(const F& f) {
+        for (auto& e : wdlTable)
+            f(e);
+        for (auto& e : dtzTable)
+            f(e);
+    }
 };
 
 TBTables TBTables;
 
 // If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
-// are created and added to the lists and hash table. Called at init time.
+// are created and added to the lists. Called at init time.
 void TBTables::add(const std::vector<PieceType>& pieces) {
 
     std::string code;
@@ -502,21 +819,245 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
     for (PieceType pt : pieces)
         code += PieceToChar[pt];
 
-    TBFile file(code.insert(code.find('K', 1), "v") + ".rtbw");  // KRK -> KRvK
+    code.insert(code.find('K', 1), "v");  // KRK -> KRvK
 
-    if (!file.is_open())  // Only WDL file is checked
+    if (!TBFile::exists(code + ".rtbw"))  // Only WDL file is checked
         return;
 
-    file.close();
-
     MaxCardinality = std::max(int(pieces.size()), MaxCardinality);
 
     wdlTable.emplace_back(code);
     dtzTable.emplace_back(wdlTable.back());
+    codes.push_back(code);
+}
+
+// Builds the hash table once all the tables have been added, sized after their
+// number so that 7-man sets do not need more probing than smaller ones.
+void TBTables::build() {
+
+    size_t buckets = 16;
+    while (buckets < BucketsPerKey * 2 * wdlTable.size())
+        buckets *= 2;
+
+    keys.assign(buckets, 0);
+    wdlTables.assign(buckets, nullptr);
+    dtzTables.assign(buckets, nullptr);
+    mask = buckets - 1;
 
     // Insert into the hash keys for both colors: KRvK with KR white and black
-    insert(wdlTable.back().key, &wdlTable.back(), &dtzTable.back());
-    insert(wdlTable.back().key2, &wdlTable.back(), &dtzTable.back());
+    for (size_t i = 0; i < wdlTable.size(); ++i)
+    {
+        insert(wdlTable[i].key, &wdlTable[i], &dtzTable[i]);
+        insert(wdlTable[i].key2, &wdlTable[i], &dtzTable[i]);
+    }
+
+    // Every table must be found, from both colors, once all of them are in
+    for (size_t i = 0; i < wdlTable.size(); ++i)
+        assert(get<WDL>(wdlTable[i].key) == &wdlTable[i]
+               && get<WDL>(wdlTable[i].key2) == &wdlTable[i]
+               && get<DTZ>(wdlTable[i].key) == &dtzTable[i]
+               && get<DTZ>(wdlTable[i].key2) == &dtzTable[i]);
+}
+
+// WDLCache keeps the results of probe_wdl(), shared by all the threads. An entry
+// packs the upper 60 bits of the position key with the score and the zeroing
+// flag in a single 64-bit word, so it is read and written atomically without any
+// lock. Colliding positions simply overwrite each other, a stale or torn entry
+// can only be missed, never returned for the wrong position.
+class WDLCache {
+
+    // The counters are split in stripes, on separate cache lines, selected by
+    // the key, so that the threads do not all update the same line.
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> probes, hits, tableProbes;
+    };
+
+    static constexpr size_t Stripes = 16;
+
+    LargePagePtr<std::atomic<uint64_t>[]> table;
+    size_t                                count = 0;
+    Stripe                                stripes[Stripes];
+
+   public:
+    size_t sizeMB = 0;
+
+    // Not thread safe, called only when the tables are (re)loaded
+    void resize(size_t mb) {
+        count = mb * 1024 * 1024 / sizeof(uint64_t);
+        table = count ? make_unique_large_page<std::atomic<uint64_t>[]>(count) : nullptr;
+
+        for (Stripe& s : stripes)
+            s.probes = s.hits = s.tableProbes = 0;
+    }
+
+    bool probe(Key key, WDLScore* wdl, ProbeState* result) {
+        if (!count)
+            return false;
+
+        Stripe&  s     = stripes[key % Stripes];
+        uint64_t entry = table[mul_hi64(key, count)].load(std::memory_order_relaxed);
+
+        s.probes.fetch_add(1, std::memory_order_relaxed);
+
+        if (!(entry & 7) || (entry >> 4) != (key >> 4))
+            return false;
+
+        s.hits.fetch_add(1, std::memory_order_relaxed);
+        *wdl    = WDLScore(int(entry & 7) - 3);
+        *result = entry & 8 ? ZEROING_BEST_MOVE : OK;
+        return true;
+    }
+
+    void store(Key key, WDLScore wdl, ProbeState result) {
+        if (count)
+            table[mul_hi64(key, count)].store((key & ~uint64_t(15)) | uint64_t(wdl + 3)
+                                                | (result == ZEROING_BEST_MOVE) << 3,
+                                              std::memory_order_relaxed);
+    }
+
+    void count_table_probe(Key key) {
+        stripes[key % Stripes].tableProbes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string stats() const {
+        uint64_t probes = 0, hits = 0, tableProbes = 0;
+
+        for (const Stripe& s : stripes)
+        {
+            probes += s.probes.load(std::memory_order_relaxed);
+            hits += s.hits.load(std::memory_order_relaxed);
+            tableProbes += s.tableProbes.load(std::memory_order_relaxed);
+        }
+
+        // Each miss, that is each actual probe_wdl() computation, needs one or
+        // more table probes, including those of the winning captures.
+        const uint64_t misses = probes - hits;
+
+        std::ostringstream ss;
+        ss << "WDL cache " << (count * sizeof(uint64_t) >> 20) << " MB: " << probes
+           << " probes, " << hits << " hits ("
+           << (probes ? 100 * hits / probes : 0) << "%), " << tableProbes
+           << " table probes, about " << (misses ? hits * tableProbes / misses : 0)
+           << " saved";
+        return ss.str();
+    }
+};
+
+WDLCache WDLResults;
+
+// Walks the Huffman coded symbols of the given block until the one holding the
+// value at the given offset, returning it and the offset of the value within it.
+// With an entry of the block cache instead, decodes and stores all the symbols
+// of the block.
+Sym decode_symbol(PairsData* d, uint32_t block, int* offset, BlockCache::Entry* entry) {
+
+    // Find the start address of our block of canonical Huffman symbols
+    uint32_t* ptr = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
+
+    // Read the first 64 bits in our block, this is a (truncated) sequence of
+    // unknown number of symbols of unknown length but we know the first one
+    // is at the beginning of this 64-bit sequence.
+    uint64_t buf64 = number<uint64_t, BigEndian>(ptr);
+    ptr += 2;
+
+    if (CollectStats.load(std::memory_order_relaxed))
+        d->decodes->fetch_add(1, std::memory_order_relaxed);
+
+    int buf64Size = 64;
+    int end       = 0;
+    Sym sym;
+
+    while (true)
+    {
+        int len = 0;  // This is the symbol length - d->min_sym_len
+
+        // Now get the symbol length. For any symbol s64 of length l right-padded
+        // to 64 bits we know that d->base64[l-1] >= s64 >= d->base64[l] so we
+        // can find the symbol length iterating through base64[].
+        while (buf64 < d->base64[len])
+            ++len;
+
+        // All the symbols of a given length are consecutive integers (numerical
+        // sequence property), so we can compute the offset of our symbol of
+        // length len, stored at the beginning of buf64.
+        sym = Sym((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+
+        // Now add the value of the lowest symbol of length len to get our symbol
+        sym += number<Sym, LittleEndian>(&d->lowestSym[len]);
+
+        // When decoding the whole block, store the symbol and where it ends
+        if (entry)
+        {
+            entry->syms.push_back(sym);
+            end += d->symlen[sym] + 1;
+            entry->ends.push_back(uint16_t(end - 1));
+
+            if (end > d->blockLength[block])
+                return sym;
+        }
+
+        // If our offset is within the number of values represented by symbol sym,
+        // we are done.
+        else if (*offset < d->symlen[sym] + 1)
+            return sym;
+
+        // ...otherwise update the offset and continue to iterate
+        else
+            *offset -= d->symlen[sym] + 1;
+
+        len += d->minSymLen;  // Get the real length
+        buf64 <<= len;        // Consume the just processed symbol
+        buf64Size -= len;
+
+        if (buf64Size <= 32)
+        {  // Refill the buffer
+            buf64Size += 32;
+            buf64 |= uint64_t(number<uint32_t, BigEndian>(ptr++)) << (64 - buf64Size);
+        }
+    }
+}
+
+// Finds the symbol holding the value at the given offset of the block through
+// the cache, decoding the block first if it is not there. Decoding may fault the
+// block in from disk, so it is done outside the lock, and the decoded block is
+// installed afterwards, unless another thread has been quicker.
+Sym cached_symbol(PairsData* d, uint32_t block, int* offset) {
+
+    BlockCache&       cache = *d->blockCache;
+    BlockCache::Entry decoded;
+
+    auto find = [&]() {
+        return std::find_if(std::begin(cache.entries), std::end(cache.entries),
+                            [&](const auto& e) { return e.block == block; });
+    };
+
+    {
+        std::scoped_lock<std::mutex> lk(cache.mutex);
+
+        if (BlockCache::Entry* entry = find(); entry != std::end(cache.entries))
+        {
+            entry->lastUse = ++cache.clock;
+            return entry->symbol(offset);
+        }
+    }
+
+    decoded.block = block;
+    decode_symbol(d, block, nullptr, &decoded);
+    Sym sym = decoded.symbol(offset);
+
+    std::scoped_lock<std::mutex> lk(cache.mutex);
+
+    if (find() == std::end(cache.entries))
+    {
+        BlockCache::Entry* entry = std::min_element(
+          std::begin(cache.entries), std::end(cache.entries),
+          [](const auto& a, const auto& b) { return a.lastUse < b.lastUse; });
+
+        *entry         = std::move(decoded);
+        entry->lastUse = ++cache.clock;
+    }
+
+    return sym;
 }
 
 // TB tables are compressed with canonical Huffman code. The compressed data is divided into
@@ -579,52 +1120,9 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     while (offset > d->blockLength[block])
         offset -= d->blockLength[block++] + 1;
 
-    // Finally, we find the start address of our block of canonical Huffman symbols
-    uint32_t* ptr = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
-
-    // Read the first 64 bits in our block, this is a (truncated) sequence of
-    // unknown number of symbols of unknown length but we know the first one
-    // is at the beginning of this 64-bit sequence.
-    uint64_t buf64 = number<uint64_t, BigEndian>(ptr);
-    ptr += 2;
-    int buf64Size = 64;
-    Sym sym;
-
-    while (true)
-    {
-        int len = 0;  // This is the symbol length - d->min_sym_len
-
-        // Now get the symbol length. For any symbol s64 of length l right-padded
-        // to 64 bits we know that d->base64[l-1] >= s64 >= d->base64[l] so we
-        // can find the symbol length iterating through base64[].
-        while (buf64 < d->base64[len])
-            ++len;
-
-        // All the symbols of a given length are consecutive integers (numerical
-        // sequence property), so we can compute the offset of our symbol of
-        // length len, stored at the beginning of buf64.
-        sym = Sym((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
-
-        // Now add the value of the lowest symbol of length len to get our symbol
-        sym += number<Sym, LittleEndian>(&d->lowestSym[len]);
-
-        // If our offset is within the number of values represented by symbol sym,
-        // we are done.
-        if (offset < d->symlen[sym] + 1)
-            break;
-
-        // ...otherwise update the offset and continue to iterate
-        offset -= d->symlen[sym] + 1;
-        len += d->minSymLen;  // Get the real length
-        buf64 <<= len;        // Consume the just processed symbol
-        buf64Size -= len;
-
-        if (buf64Size <= 32)
-        {  // Refill the buffer
-            buf64Size += 32;
-            buf64 |= uint64_t(number<uint32_t, BigEndian>(ptr++)) << (64 - buf64Size);
-        }
-    }
+    Sym sym = d->blockCache && UseBlockCache.load(std::memory_order_relaxed)
+              ? cached_symbol(d, block, &offset)
+              : decode_symbol(d, block, &offset, nullptr);
 
     // Now we have our symbol that expands into d->symlen[sym] + 1 symbols.
     // We binary-search for our value recursively expanding into the left and
@@ -1143,7 +1641,10 @@ void set(T& e, uint8_t* data) {
     {
 
         for (int i = 0; i < sides; i++)
-            *e.get(i, f) = PairsData();
+        {
+            *e.get(i, f)          = PairsData();
+            e.get(i, f)->decodes = &e.decodes;
+        }
 
         int order[][2] = {{*data & 0xF, pp ? *(data + 1) & 0xF : 0xF},
                           {*data >> 4, pp ? *(data + 1) >> 4 : 0xF}};
@@ -1185,24 +1686,32 @@ void set(T& e, uint8_t* data) {
             data = (uint8_t*) ((uintptr_t(data) + 0x3F) & ~0x3F);  // 64 byte alignment
             (d = e.get(i, f))->data = data;
             data += d->blocksNum * d->sizeofBlock;
+
+            if (T::Sides == 1 && !(d->flags & TBFlag::SingleValue))
+                d->blockCache = std::make_unique<BlockCache>();
         }
 }
 
 // If the TB file corresponding to the given position is already memory-mapped
 // then return its base address, otherwise, try to memory map and init it. Called
 // at every probe, memory map, and init only at first access. Function is thread
-// safe and can be called concurrently.
+// safe and can be called concurrently. The lock is per table, so that threads
+// reaching different tables at the same time map them in parallel.
 template<TBType Type>
-void* mapped(TBTable<Type>& e, const Position& pos) {
+bool try_unmap(TBTable<Type>& e);
 
-    static std::mutex mutex;
+void evict(const void* keep);
+
+template<TBType Type>
+void* mapped(TBTable<Type>& e, const Position& pos) {
 
-    // Use 'acquire' to avoid a thread reading 'ready' == true while
-    // another is still working. (compiler reordering may cause this).
-    if (e.ready.load(std::memory_order_acquire))
+    // Use at least 'acquire' to avoid a thread reading 'ready' == true while
+    // another is still working. (compiler reordering may cause this). It is
+    // sequentially consistent to pair with the reader count, see try_unmap().
+    if (e.ready.load())
         return e.baseAddress;  // Could be nullptr if file does not exist
 
-    std::scoped_lock<std::mutex> lk(mutex);
+    std::scoped_lock<std::mutex> lk(e.mutex);
 
     if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
         return e.baseAddress;
@@ -1218,26 +1727,142 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     fname =
       (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w) + (Type == WDL ? ".rtbw" : ".rtbz");
 
-    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+    auto start = std::chrono::steady_clock::now();
+
+    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, &e.fileSize, Type);
 
     if (data)
+    {
         set(e, data);
+        MappedBytes += e.fileSize;
+        e.lastUse = ++MapEpoch;
+    }
+
+    e.mapTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
 
     e.ready.store(true, std::memory_order_release);
+
+    if (data && MemoryLimit && MappedBytes > MemoryLimit)
+        evict(&e);
+
     return e.baseAddress;
 }
 
+// Unmaps a table, unless it is preloaded, being probed, or mapped or unmapped
+// by another thread. A probe first counts itself as a reader and then checks
+// that the table is ready, while here the table is first flagged as not ready
+// and then the readers are checked: so either the probe sees the table not
+// ready, and waits on the lock to map it again, or the reader is seen here and
+// the table is left alone.
+template<TBType Type>
+bool try_unmap(TBTable<Type>& e) {
+
+    std::unique_lock<std::mutex> lk(e.mutex, std::try_to_lock);
+
+    if (!lk.owns_lock() || !e.ready.load(std::memory_order_relaxed) || !e.baseAddress
+        || e.preloaded.load(std::memory_order_relaxed))
+        return false;
+
+    e.ready.store(false);
+
+    for (const ReaderCount& r : e.readers)
+        if (r.count.load())
+        {
+            e.ready.store(true);
+            return false;
+        }
+
+    TBFile::unmap(e.baseAddress, e.mapping);
+    e.baseAddress = nullptr;
+    MappedBytes -= e.fileSize;
+    ++Unmapped;
+    return true;
+}
+
+// Unmaps the least recently probed tables, but the given one, until the mapped
+// tables fit in MemoryLimit. Called after a table has been mapped only, that is
+// rarely, so going through all the tables is fine.
+void evict(const void* keep) {
+
+    std::vector<std::pair<uint64_t, std::function<bool()>>> candidates;
+
+    // Tables not mapped, or being unmapped, are skipped later by try_unmap()
+    TBTables.for_each([&](auto& e) {
+        if (&e != keep && e.ready.load(std::memory_order_relaxed))
+            candidates.emplace_back(e.lastUse.load(std::memory_order_relaxed),
+                                    [&e]() { return try_unmap(e); });
+    });
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    for (auto& candidate : candidates)
+    {
+        if (MappedBytes <= MemoryLimit)
+            break;
+
+        candidate.second();
+    }
+}
+
+// With a memory limit, counts a probe as a reader of the table for its lifetime,
+// so that the table is not unmapped meanwhile, and records the probe for the
+// LRU order. Without a limit tables are never unmapped and nothing is counted.
+template<typename T>
+struct TableReader {
+
+    explicit TableReader(T* t) :
+        e(MemoryLimit ? t : nullptr),
+        stripe(reader_stripe()) {
+
+        if (!e)
+            return;
+
+        e->readers[stripe].count.fetch_add(1);
+
+        uint64_t epoch = MapEpoch.load(std::memory_order_relaxed);
+        if (e->lastUse.load(std::memory_order_relaxed) != epoch)
+            e->lastUse.store(epoch, std::memory_order_relaxed);
+    }
+
+    ~TableReader() {
+        if (e)
+            e->readers[stripe].count.fetch_sub(1, std::memory_order_release);
+    }
+
+    TableReader(const TableReader&)            = delete;
+    TableReader& operator=(const TableReader&) = delete;
+
+    T* const     e;
+    const size_t stripe;
+};
+
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
 Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
 
     if (pos.count<ALL_PIECES>() == 2)  // KvK
         return Ret(WDLDraw);
 
-    TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
+    TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
+
+    if (CollectStats.load(std::memory_order_relaxed))
+    {
+        if (!entry)
+            MissingTableProbes.fetch_add(1, std::memory_order_relaxed);
+        else
+            entry->probes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TableReader<TBTable<Type>> reader(entry);
 
     if (!entry || !mapped(*entry, pos))
         return *result = FAIL, Ret();
 
+    if (CollectStats.load(std::memory_order_relaxed))
+        entry->hits.fetch_add(1, std::memory_order_relaxed);
+
     return do_probe_table(pos, entry, wdl, result);
 }
 
@@ -1301,6 +1926,7 @@ WDLScore search(Position& pos, ProbeState* result) {
         value = bestValue;
     else
     {
+        WDLResults.count_table_probe(pos.raw_key());
         value = probe_table<WDL>(pos, result);
 
         if (*result == FAIL)
@@ -1320,15 +1946,25 @@ WDLScore search(Position& pos, ProbeState* result) {
 // Called at startup and after every change to
 // "SyzygyPath" UCI option to (re)create the various tables. It is not thread
 // safe, nor it needs to be.
-void Tablebases::init(const std::string& paths) {
+void Tablebases::init(const std::string& paths, const std::string& indexFile) {
 
     TBTables.clear();
-    MaxCardinality = 0;
-    TBFile::Paths  = paths;
+    WDLResults.resize(0);
+
+    MappedBytes = MapEpoch = Unmapped = 0;
+
+    WDLLatency.clear();
+    DTZLatency.clear();
+    MissingTableProbes = 0;
+    MaxCardinality    = 0;
+    TBFile::Paths     = paths;
+    TBFile::IndexFile = indexFile == "<empty>" ? "" : indexFile;
 
     if (paths.empty() || paths == "<empty>")
         return;
 
+    TBFile::scan(TBFile::IndexFile);
+
     // MapB1H1H7[] encodes a square below a1-h8 diagonal to 0..27
     int code = 0;
     for (Square s = SQ_A1; s <= SQ_H8; ++s)
@@ -1466,50 +2102,137 @@ void Tablebases::init(const std::string& paths) {
         }
     }
 
+    TBTables.build();
+
+    if (TBTables.size())
+        WDLResults.resize(WDLResults.sizeMB);
+
     sync_cout << "info string Found " << TBTables.size() << " tablebases" << sync_endl;
 }
 
-// Probe the WDL table for a particular position.
-// If *result != FAIL, the probe was successful.
-// The return value is from the point of view of the side to move:
-// -2 : loss
-// -1 : loss, but draw under 50-move rule
-//  0 : draw
-//  1 : win, but draw under 50-move rule
-//  2 : win
-WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
+// Sets the size of the WDL cache, allocated only when tablebases are found. Like
+// init(), it must not be called during a search.
+void Tablebases::set_wdl_cache_size(size_t mb) {
+
+    WDLResults.sizeMB = mb;
+
+    if (TBTables.size())
+        WDLResults.resize(mb);
+}
+
+std::string Tablebases::wdl_cache_stats() { return WDLResults.stats(); }
+
+void Tablebases::set_stats(bool enable) { CollectStats.store(enable, std::memory_order_relaxed); }
+
+// Must not be called while searching, the probes in progress would not be
+// counted as readers of their tables. A lower limit is enforced at the next
+// mapping.
+void Tablebases::set_memory_limit(size_t mb) { MemoryLimit = uint64_t(mb) << 20; }
+
+// Reports the tables currently mapped and their size, the working set of the
+// search when a memory limit is set.
+std::string Tablebases::mapping_stats() {
+
+    size_t files = 0;
+
+    TBTables.for_each([&](auto& e) {
+        std::scoped_lock<std::mutex> lk(e.mutex);
+        files += e.baseAddress != nullptr;
+    });
+
+    std::ostringstream ss;
+    ss << "Mapped " << files << " files of " << TBTables.size() << " tablebases: "
+       << (MappedBytes.load() >> 20) << " MB";
+
+    if (MemoryLimit)
+        ss << " of " << (MemoryLimit >> 20) << " MB limit, " << Unmapped.load()
+           << " files unmapped";
+
+    return ss.str();
+}
+
+// Reports the probe statistics collected since the tables were loaded: the
+// latency of probe_wdl() and probe_dtz(), then the most probed tables with
+// their probes, failed probes, decompressed blocks and first access time.
+std::string Tablebases::stats(size_t maxTables) {
+
+    struct Row {
+        std::string code;
+        uint64_t    probes[2], failed[2], decodes[2], mapTime[2];
+    };
+
+    std::vector<Row> rows;
+    StateInfo        st;
+    Position         pos;
+
+    auto fill = [](Row& r, int i, auto& e) {
+        r.probes[i]  = e.probes.load(std::memory_order_relaxed);
+        r.failed[i]  = r.probes[i] - e.hits.load(std::memory_order_relaxed);
+        r.decodes[i] = e.decodes.load(std::memory_order_relaxed);
+        r.mapTime[i] = e.ready.load(std::memory_order_acquire) ? e.mapTime : 0;
+    };
+
+    for (const std::string& code : TBTables.material_codes())
+    {
+        Row r;
+        r.code = code;
+        pos.set(code, WHITE, &st);
+        fill(r, 0, *TBTables.get<WDL>(pos.material_key()));
+        fill(r, 1, *TBTables.get<DTZ>(pos.material_key()));
+
+        if (r.probes[0] + r.probes[1])
+            rows.push_back(r);
+    }
+
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.probes[0] + a.probes[1] > b.probes[0] + b.probes[1];
+    });
+
+    std::ostringstream ss;
+
+    if (!CollectStats.load(std::memory_order_relaxed))
+        ss << "Probe statistics are collected only with SyzygyStats enabled\n";
+
+    ss << mapping_stats() << "\n"
+       << WDLLatency.to_string("probe_wdl") << "\n"
+       << DTZLatency.to_string("probe_dtz") << "\n"
+       << MissingTableProbes.load(std::memory_order_relaxed)
+       << " probes of missing tables, " << rows.size() << " of " << TBTables.size()
+       << " tables probed";
+
+    for (size_t i = 0; i < std::min(maxTables, rows.size()); ++i)
+    {
+        const Row& r = rows[i];
+        ss << "\n" << r.code;
+
+        for (int t : {0, 1})
+            ss << (t ? " | DTZ " : " WDL ") << r.probes[t] << " probes, " << r.failed[t]
+               << " failed, " << r.decodes[t] << " blocks, mapped in " << r.mapTime[t] << " us";
+    }
+
+    return ss.str();
+}
+
+namespace {
+
+// probe_wdl() and probe_dtz() without the timing, the latter calls itself
+WDLScore do_probe_wdl(Position& pos, ProbeState* result) {
+
+    WDLScore wdl;
+
+    if (WDLResults.probe(pos.raw_key(), &wdl, result))
+        return wdl;
 
     *result = OK;
-    return search<false>(pos, result);
+    wdl     = search<false>(pos, result);
+
+    if (*result != FAIL)
+        WDLResults.store(pos.raw_key(), wdl, *result);
+
+    return wdl;
 }
 
-// Probe the DTZ table for a particular position.
-// If *result != FAIL, the probe was successful.
-// The return value is from the point of view of the side to move:
-//         n < -100 : loss, but draw under 50-move rule
-// -100 <= n < -1   : loss in n ply (assuming 50-move counter == 0)
-//        -1        : loss, the side to move is mated
-//         0        : draw
-//     1 < n <= 100 : win in n ply (assuming 50-move counter == 0)
-//   100 < n        : win, but draw under 50-move rule
-//
-// The return value n can be off by 1: a return value -n can mean a loss
-// in n+1 ply and a return value +n can mean a win in n+1 ply. This
-// cannot happen for tables with positions exactly on the "edge" of
-// the 50-move rule.
-//
-// This implies that if dtz > 0 is returned, the position is certainly
-// a win if dtz + 50-move-counter <= 99. Care must be taken that the engine
-// picks moves that preserve dtz + 50-move-counter <= 99.
-//
-// If n = 100 immediately after a capture or pawn move, then the position
-// is also certainly a win, and during the whole phase until the next
-// capture or pawn move, the inequality to be preserved is
-// dtz + 50-move-counter <= 100.
-//
-// In short, if a move is available resulting in dtz + 50-move-counter <= 99,
-// then do not accept moves leading to dtz + 50-move-counter == 100.
-int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
+int do_probe_dtz(Position& pos, ProbeState* result) {
 
     *result      = OK;
     WDLScore wdl = search<true>(pos, result);
@@ -1545,7 +2268,7 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
         // otherwise we will get the dtz of the next move sequence. Search the
         // position after the move to get the score sign (because even in a
         // winning position we could make a losing capture or go for a draw).
-        dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result)) : -probe_dtz(pos, result);
+        dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result)) : -do_probe_dtz(pos, result);
 
         // If the move mates, force minDTZ to 1
         if (dtz == 1 && pos.checkers() && MoveList<LEGAL>(pos).size() == 0)
@@ -1570,14 +2293,74 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
     return minDTZ == 0xFFFF ? -1 : minDTZ;
 }
 
+}  // namespace
+
+// Probe the WDL table for a particular position.
+// If *result != FAIL, the probe was successful.
+// The return value is from the point of view of the side to move:
+// -2 : loss
+// -1 : loss, but draw under 50-move rule
+//  0 : draw
+//  1 : win, but draw under 50-move rule
+//  2 : win
+WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
+
+    if (!CollectStats.load(std::memory_order_relaxed))
+        return do_probe_wdl(pos, result);
+
+    auto     start = std::chrono::steady_clock::now();
+    WDLScore wdl   = do_probe_wdl(pos, result);
+
+    WDLLatency.add(std::chrono::steady_clock::now() - start);
+    return wdl;
+}
+
+// Probe the DTZ table for a particular position.
+// If *result != FAIL, the probe was successful.
+// The return value is from the point of view of the side to move:
+//         n < -100 : loss, but draw under 50-move rule
+// -100 <= n < -1   : loss in n ply (assuming 50-move counter == 0)
+//        -1        : loss, the side to move is mated
+//         0        : draw
+//     1 < n <= 100 : win in n ply (assuming 50-move counter == 0)
+//   100 < n        : win, but draw under 50-move rule
+//
+// The return value n can be off by 1: a return value -n can mean a loss
+// in n+1 ply and a return value +n can mean a win in n+1 ply. This
+// cannot happen for tables with positions exactly on the "edge" of
+// the 50-move rule.
+//
+// This implies that if dtz > 0 is returned, the position is certainly
+// a win if dtz + 50-move-counter <= 99. Care must be taken that the engine
+// picks moves that preserve dtz + 50-move-counter <= 99.
+//
+// If n = 100 immediately after a capture or pawn move, then the position
+// is also certainly a win, and during the whole phase until the next
+// capture or pawn move, the inequality to be preserved is
+// dtz + 50-move-counter <= 100.
+//
+// In short, if a move is available resulting in dtz + 50-move-counter <= 99,
+// then do not accept moves leading to dtz + 50-move-counter == 100.
+int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
+
+    if (!CollectStats.load(std::memory_order_relaxed))
+        return do_probe_dtz(pos, result);
+
+    auto start = std::chrono::steady_clock::now();
+    int  dtz   = do_probe_dtz(pos, result);
+
+    DTZLatency.add(std::chrono::steady_clock::now() - start);
+    return dtz;
+}
+
 
 // Use the DTZ tables to rank root moves.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
-
-    ProbeState result = OK;
-    StateInfo  st;
+bool Tablebases::root_probe(Position&          pos,
+                            Search::RootMoves& rootMoves,
+                            bool               rule50,
+                            ThreadPool*        threads) {
 
     // Obtain 50-move counter for the root position
     int cnt50 = pos.rule50_count();
@@ -1585,21 +2368,24 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool ru
     // Check whether a position was repeated since the last zeroing move.
     bool rep = pos.has_repeated();
 
-    int dtz, bound = rule50 ? (MAX_DTZ - 100) : 1;
+    int bound = rule50 ? (MAX_DTZ - 100) : 1;
 
-    // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
+    // Probes and ranks a move, returns false if a probe failed
+    auto rank = [&](Position& p, Search::RootMove& m) {
+        ProbeState result = OK;
+        StateInfo  st;
+        int        dtz;
+
+        p.do_move(m.pv[0], st);
 
         // Calculate dtz for the current move counting from the root position
-        if (pos.rule50_count() == 0)
+        if (p.rule50_count() == 0)
         {
             // In case of a zeroing move, dtz is one of -101/-1/0/1/101
-            WDLScore wdl = -probe_wdl(pos, &result);
+            WDLScore wdl = -probe_wdl(p, &result);
             dtz          = dtz_before_zeroing(wdl);
         }
-        else if (pos.is_draw(1))
+        else if (p.is_draw(1))
         {
             // In case a root move leads to a draw by repetition or 50-move rule,
             // we set dtz to zero. Note: since we are only 1 ply from the root,
@@ -1609,15 +2395,15 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool ru
         else
         {
             // Otherwise, take dtz for the new position and correct by 1 ply
-            dtz = -probe_dtz(pos, &result);
+            dtz = -probe_dtz(p, &result);
             dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
         }
 
         // Make sure that a mating move is assigned a dtz value of 1
-        if (pos.checkers() && dtz == 2 && MoveList<LEGAL>(pos).size() == 0)
+        if (p.checkers() && dtz == 2 && MoveList<LEGAL>(p).size() == 0)
             dtz = 1;
 
-        pos.undo_move(m.pv[0]);
+        p.undo_move(m.pv[0]);
 
         if (result == FAIL)
             return false;
@@ -1637,9 +2423,38 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool ru
                   : r == 0     ? VALUE_DRAW
                   : r > -bound ? Value((std::min(-3, r + (MAX_DTZ - 200)) * int(PawnValue)) / 200)
                                : -VALUE_MATE + MAX_PLY + 1;
-    }
+        return true;
+    };
 
-    return true;
+    const size_t threadCount = threads ? std::min(threads->num_threads(), rootMoves.size()) : 1;
+
+    if (threadCount <= 1)
+        return std::all_of(rootMoves.begin(), rootMoves.end(),
+                           [&](Search::RootMove& m) { return rank(pos, m); });
+
+    // Probing can take long with cold pages, so share the moves among the idle
+    // threads, each on its own copy of the root position. As for the search, the
+    // copy's root state is the one of the game, with the game history behind it.
+    const std::string fen = pos.fen();
+    std::atomic_bool  ok{true};
+
+    for (size_t t = 0; t < threadCount; ++t)
+        threads->run_on_thread(t, [&, t]() {
+            StateInfo rootState;
+            Position  p;
+
+            p.set(fen, pos.is_chess960(), &rootState);
+            rootState = *pos.state();
+
+            for (size_t i = t; i < rootMoves.size() && ok; i += threadCount)
+                if (!rank(p, rootMoves[i]))
+                    ok = false;
+        });
+
+    for (size_t t = 0; t < threadCount; ++t)
+        threads->wait_on_thread(t);
+
+    return ok;
 }
 
 
@@ -1683,7 +2498,8 @@ bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, boo
 
 Config Tablebases::rank_root_moves(const OptionsMap&  options,
                                    Position&          pos,
-                                   Search::RootMoves& rootMoves) {
+                                   Search::RootMoves& rootMoves,
+                                   ThreadPool*        threads) {
     Config config;
 
     if (rootMoves.empty())
@@ -1706,8 +2522,10 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
 
     if (config.cardinality >= popcount(pos.pieces()) && !pos.can_castle(ANY_CASTLING))
     {
+        TimePoint elapsed = now();
+
         // Rank moves using DTZ tables
-        config.rootInTB = root_probe(pos, rootMoves, options["Syzygy50MoveRule"]);
+        config.rootInTB = root_probe(pos, rootMoves, options["Syzygy50MoveRule"], threads);
 
         if (!config.rootInTB)
         {
@@ -1715,6 +2533,13 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
             dtz_available   = false;
             config.rootInTB = root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"]);
         }
+
+        elapsed = now() - elapsed;
+
+        if (config.rootInTB)
+            sync_cout << "info string Ranked " << rootMoves.size() << " root moves with "
+                      << (dtz_available ? "DTZ" : "WDL") << " tables in " << elapsed << " ms"
+                      << sync_endl;
     }
 
     if (config.rootInTB)
@@ -1737,4 +2562,254 @@ Config Tablebases::rank_root_moves(const OptionsMap&  options,
 
     return config;
 }
+
+// Maps up front the tables with up to the given number of pieces and reads them
+// into memory, so that the first probes of a game do not stall on page faults.
+// The WDL tables, the ones probed during the search, can also be locked there.
+// Returns a one line report of the work done.
+std::string Tablebases::preload(int maxPieces, bool lockWDL) {
+
+    TimePoint elapsed = now();
+    size_t    tables  = 0;
+    uint64_t  bytes = 0, resident = 0, locked = 0;
+    StateInfo st;
+    Position  pos;
+
+    auto load = [&](auto& e, bool lock) {
+        TableReader<std::remove_reference_t<decltype(e)>> reader(&e);
+
+        if (mapped(e, pos))
+        {
+            uint64_t wasLocked = locked;
+
+            e.preloaded.store(true, std::memory_order_relaxed);
+            bytes += e.fileSize;
+            resident += TBFile::preload(e.baseAddress, e.fileSize, lock, &locked);
+            e.locked |= locked != wasLocked;
+        }
+    };
+
+    unlock_wdl();
+
+    for (const std::string& code : TBTables.material_codes())
+    {
+        pos.set(code, WHITE, &st);
+
+        if (pos.count<ALL_PIECES>() > maxPieces)
+            continue;
+
+        load(*TBTables.get<WDL>(pos.material_key()), lockWDL);
+        load(*TBTables.get<DTZ>(pos.material_key()), false);
+        ++tables;
+    }
+
+    elapsed = now() - elapsed;
+
+    std::ostringstream ss;
+    ss << "Preloaded " << tables << " tablebases of up to " << maxPieces << " pieces: "
+       << (bytes >> 20) << " MB mapped, " << (resident >> 20) << " MB resident, "
+       << (locked >> 20) << " MB locked in " << elapsed << " ms";
+
+    return ss.str();
+}
+
+// Unlocks the WDL tables locked in memory by preload(). Unmapping a table, as
+// init() does, also unlocks it.
+void Tablebases::unlock_wdl() {
+
+    StateInfo st;
+    Position  pos;
+
+    for (const std::string& code : TBTables.material_codes())
+    {
+        TBTable<WDL>& e = *TBTables.get<WDL>(pos.set(code, WHITE, &st).material_key());
+
+        if (e.locked)
+        {
+            TBFile::unlock(e.baseAddress, e.fileSize);
+            e.locked = false;
+        }
+    }
+}
+
+// Measures the latency of the first access to the tables, the one that memory
+// maps them, when the given number of threads reach them at the same time. The
+// tables are reloaded first, then every thread touches the WDL and DTZ tables of
+// all of them, each starting at a different table so that some threads map
+// tables in parallel while others wait for a table being mapped.
+std::string Tablebases::map_bench(size_t threadCount) {
+
+    using Clock = std::chrono::steady_clock;
+
+    init(TBFile::Paths, TBFile::IndexFile);  // Unmap all the tables
+
+    const std::vector<std::string>& codes = TBTables.material_codes();
+
+    if (codes.empty())
+        return "No tablebases found, set SyzygyPath first";
+
+    std::deque<StateInfo>                  states;
+    std::vector<std::unique_ptr<Position>> positions;
+
+    for (const std::string& code : codes)
+    {
+        positions.push_back(std::make_unique<Position>());
+        positions.back()->set(code, WHITE, &states.emplace_back());
+    }
+
+    threadCount = std::max(threadCount, size_t(1));
+
+    std::atomic_bool             go{false};
+    std::vector<std::thread>     threads;
+    std::vector<Clock::duration> maxLatency(threadCount), sumLatency(threadCount);
+
+    for (size_t t = 0; t < threadCount; ++t)
+        threads.emplace_back([&, t]() {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                const Position& pos = *positions[(i + t * positions.size() / threadCount)
+                                                 % positions.size()];
+                Clock::time_point start = Clock::now();
+
+                mapped(*TBTables.get<WDL>(pos.material_key()), pos);
+                mapped(*TBTables.get<DTZ>(pos.material_key()), pos);
+
+                Clock::duration latency = Clock::now() - start;
+                maxLatency[t]           = std::max(maxLatency[t], latency);
+                sumLatency[t] += latency;
+            }
+        });
+
+    Clock::time_point start = Clock::now();
+    go.store(true, std::memory_order_release);
+
+    for (std::thread& th : threads)
+        th.join();
+
+    auto us = [](Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    };
+
+    Clock::duration elapsed = Clock::now() - start, sum{}, max{};
+
+    for (size_t t = 0; t < threadCount; ++t)
+    {
+        sum += sumLatency[t];
+        max = std::max(max, maxLatency[t]);
+    }
+
+    std::ostringstream ss;
+    ss << "Tables           : " << codes.size() << "\nThreads          : " << threadCount
+       << "\nTotal time (us)  : " << us(elapsed)
+       << "\nAvg latency (us) : " << us(sum) / int64_t(threadCount * codes.size())
+       << "\nMax latency (us) : " << us(max);
+
+    return ss.str();
+}
+
+// Measures the DTZ probes per second, without and with the cache of decoded
+// blocks. For random legal positions of every table with up to the given number
+// of pieces, it probes the position and all its children, like root_probe()
+// does, and checks that both runs give the same results.
+std::string Tablebases::dtz_bench(int maxPieces, size_t positionsPerTable) {
+
+    std::deque<StateInfo>                  states;
+    std::vector<std::unique_ptr<Position>> positions;
+    PRNG                                   rng(1070372);
+
+    for (const std::string& code : TBTables.material_codes())
+    {
+        if (int(code.size()) - 1 > maxPieces)
+            continue;
+
+        for (size_t n = 0; n < positionsPerTable;)
+        {
+            // Place the pieces, strong side in upper case, on random empty squares
+            char board[SQUARE_NB];
+            std::fill(std::begin(board), std::end(board), '1');
+
+            bool strong = true;
+            for (char c : code)
+            {
+                if (c == 'v')
+                {
+                    strong = false;
+                    continue;
+                }
+
+                Square sq;
+                do
+                    sq = Square(rng.rand<unsigned>() % SQUARE_NB);
+                while (board[sq] != '1'
+                       || (c == 'P' && (rank_of(sq) == RANK_1 || rank_of(sq) == RANK_8)));
+
+                board[sq] = strong ? c : char(tolower(c));
+            }
+
+            std::string fen;
+            for (Rank r = RANK_8; r >= RANK_1; --r)
+                fen += std::string(board + 8 * r, 8) + (r > RANK_1 ? "/" : "");
+
+            fen += rng.rand<unsigned>() & 1 ? " w - - 0 1" : " b - - 0 1";
+
+            auto pos = std::make_unique<Position>();
+            pos->set(fen, false, &states.emplace_back());
+
+            Color them = ~pos->side_to_move();
+
+            if (!(pos->attackers_to(pos->square<KING>(them)) & pos->pieces(~them)))
+            {
+                positions.push_back(std::move(pos));
+                ++n;
+            }
+        }
+    }
+
+    if (positions.empty())
+        return "No tablebases found, set SyzygyPath first";
+
+    std::ostringstream ss;
+    std::vector<int>   results[3];
+    StateInfo          st;
+    ProbeState         state;
+
+    ss << "Positions        : " << positions.size();
+
+    // The first run, not timed, maps the tables and reads them into memory
+    for (int run : {0, 1, 2})
+    {
+        UseBlockCache.store(run == 2, std::memory_order_relaxed);
+        TimePoint elapsed = now();
+
+        for (auto& pos : positions)
+        {
+            results[run].push_back(probe_dtz(*pos, &state));
+
+            for (const Move m : MoveList<LEGAL>(*pos))
+            {
+                pos->do_move(m, st);
+                results[run].push_back(probe_dtz(*pos, &state));
+                pos->undo_move(m);
+            }
+        }
+
+        elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+        if (run)
+            ss << (run == 1 ? "\nWithout cache    : " : "\nWith cache       : ")
+               << 1000 * results[run].size() / elapsed << " probes/s";
+    }
+
+    UseBlockCache.store(true, std::memory_order_relaxed);
+
+    ss << "\nMismatches       : "
+       << std::inner_product(results[1].begin(), results[1].end(), results[2].begin(), 0,
+                             std::plus<>(), std::not_equal_to<>());
+
+    return ss.str();
+}
+
 }  // namespace Stockfish
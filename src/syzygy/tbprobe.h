@@ -19,6 +19,7 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,7 @@
 namespace Stockfish {
 class Position;
 class OptionsMap;
+class ThreadPool;
 
 using Depth = int;
 
@@ -63,12 +65,29 @@ enum ProbeState {
 extern int MaxCardinality;
 
 
-void     init(const std::string& paths);
+void     init(const std::string& paths, const std::string& indexFile = "");
 WDLScore probe_wdl(Position& pos, ProbeState* result);
 int      probe_dtz(Position& pos, ProbeState* result);
-bool     root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50);
+bool     root_probe(Position&          pos,
+                    Search::RootMoves& rootMoves,
+                    bool               rule50,
+                    ThreadPool*        threads = nullptr);
 bool     root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-Config   rank_root_moves(const OptionsMap& options, Position& pos, Search::RootMoves& rootMoves);
+Config   rank_root_moves(const OptionsMap&  options,
+                         Position&          pos,
+                         Search::RootMoves& rootMoves,
+                         ThreadPool*        threads = nullptr);
+
+void        set_wdl_cache_size(size_t mb);
+std::string wdl_cache_stats();
+void        set_stats(bool enable);
+void        set_memory_limit(size_t mb);
+std::string mapping_stats();
+std::string stats(size_t maxTables);
+std::string preload(int maxPieces, bool lockWDL);
+void        unlock_wdl();
+std::string map_bench(size_t threadCount);
+std::string dtz_bench(int maxPieces, size_t positionsPerTable);
 
 }  // namespace Stockfish::Tablebases
 
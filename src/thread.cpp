@@ -41,20 +41,31 @@ namespace Stockfish {
 Thread::Thread(Search::SharedState&                    sharedState,
                std::unique_ptr<Search::ISearchManager> sm,
                size_t                                  n,
-               OptionalThreadToNumaNodeBinder          binder) :
+               OptionalThreadToNumaNodeBinder          binder,
+               LargePagePtr<Search::Histories>*        sharedHistories) :
     idx(n),
     nthreads(sharedState.options["Threads"]),
     stdThread(&Thread::idle_loop, this) {
 
     wait_for_search_finished();
 
-    run_custom_job([this, &binder, &sharedState, &sm, n]() {
+    run_custom_job([this, &binder, &sharedState, &sm, n, sharedHistories]() {
         // Use the binder to [maybe] bind the threads to a NUMA node before doing
-        // the Worker allocation.
+        // the Worker allocation, so that its history tables are first touched, and
+        // thus placed, on the node that uses them. The Worker is several megabytes
+        // and accessed randomly, so large pages also save a lot of TLB misses.
         // Ideally we would also allocate the SearchManager here, but that's minor.
         this->numaAccessToken = binder();
-        this->worker =
-          std::make_unique<Search::Worker>(sharedState, std::move(sm), n, this->numaAccessToken);
+
+        // The first thread of a NUMA node allocates the shared histories, if any,
+        // and is the one that clears them.
+        const bool firstOnNode = sharedHistories && !*sharedHistories;
+        if (firstOnNode)
+            *sharedHistories = make_unique_large_page<Search::Histories>();
+
+        this->worker = make_unique_large_page<Search::Worker>(
+          sharedState, std::move(sm), n, this->numaAccessToken,
+          sharedHistories ? sharedHistories->get() : nullptr, firstOnNode);
     });
 
     wait_for_search_finished();
@@ -132,6 +143,24 @@ Search::SearchManager* ThreadPool::main_manager() { return main_thread()->worker
 uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
 uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
 
+// Memory used by the search state of each thread, not counting the shared histories
+size_t ThreadPool::worker_memory_footprint() const {
+    return sizeof(Search::Worker) + (sharedHistories.empty() ? sizeof(Search::Histories) : 0);
+}
+
+size_t ThreadPool::shared_histories_count() const { return sharedHistories.size(); }
+
+// In deterministic mode, counts the nodes of the other threads as they were at the
+// end of the last round, so that the output of a running search is reproducible.
+uint64_t ThreadPool::round_nodes_searched(const Search::Worker& reporter) const {
+
+    uint64_t sum = reporter.nodes;
+    for (auto&& th : threads)
+        if (th->worker.get() != &reporter)
+            sum += th->worker->roundEnd - roundNodes;
+    return sum;
+}
+
 // Creates/destroys threads to match the requested number.
 // Created and launched threads will immediately go to sleep in idle_loop.
 // Upon resizing, threads are recreated to allow for binding if necessary.
@@ -146,6 +175,7 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
         threads.clear();
 
         boundThreadToNumaNode.clear();
+        sharedHistories.clear();
     }
 
     const size_t requested = sharedState.options["Threads"];
@@ -174,6 +204,12 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
                                 ? numaConfig.distribute_threads_among_numa_nodes(requested)
                                 : std::vector<NumaIndex>{};
 
+        // Sharing histories makes the search timing dependent, so it is not
+        // compatible with the deterministic SMP mode.
+        if (sharedState.options["SharedHistory"]
+            && sharedState.options["SMPMode"] != "Deterministic")
+            sharedHistories.resize(doBindThreads ? numaConfig.num_numa_nodes() : 1);
+
         while (threads.size() < requested)
         {
             const size_t    threadId = threads.size();
@@ -189,8 +225,9 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
             auto binder = doBindThreads ? OptionalThreadToNumaNodeBinder(numaConfig, numaId)
                                         : OptionalThreadToNumaNodeBinder(numaId);
 
-            threads.emplace_back(
-              std::make_unique<Thread>(sharedState, std::move(manager), threadId, binder));
+            threads.emplace_back(std::make_unique<Thread>(
+              sharedState, std::move(manager), threadId, binder,
+              sharedHistories.empty() ? nullptr : &sharedHistories[numaId]));
         }
 
         clear();
@@ -211,6 +248,13 @@ void ThreadPool::clear() {
     for (auto&& th : threads)
         th->wait_for_search_finished();
 
+    currentlySearching.clear();
+
+    {
+        std::scoped_lock<std::mutex> lk(searchStatsMutex);
+        searchStats.clear();
+    }
+
     // These two affect the time taken on the first move of a game:
     main_manager()->bestPreviousAverageScore = VALUE_INFINITE;
     main_manager()->previousTimeReduction    = 0.85;
@@ -237,7 +281,7 @@ size_t ThreadPool::num_threads() const { return threads.size(); }
 // returns immediately. Main thread will wake up other threads and start the search.
 void ThreadPool::start_thinking(const OptionsMap&  options,
                                 Position&          pos,
-                                StateListPtr&      states,
+                                const StateArena&  states,
                                 Search::LimitsType limits) {
 
     main_thread()->wait_for_search_finished();
@@ -247,6 +291,18 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
 
     increaseDepth = true;
 
+    deferMoves    = options["SMPMode"] == "ABDADA" && threads.size() > 1;
+    deterministic = options["SMPMode"] == "Deterministic" && threads.size() > 1;
+
+    currentlySearching.enable(deferMoves);
+
+    // Short rounds for small node limits, so that the limit is not overshot by much
+    roundNodes = limits.nodes ? std::clamp(limits.nodes / (4 * threads.size()), uint64_t(64),
+                                           uint64_t(4096))
+                              : 4096;
+    roundParticipants = roundArrived = 0;
+    roundStopRequested                = false;
+
     Search::RootMoves rootMoves;
     const auto        legalmoves = MoveList<LEGAL>(pos);
 
@@ -262,19 +318,12 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
         for (const auto& m : legalmoves)
             rootMoves.emplace_back(m);
 
-    Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
-
-    // After ownership transfer 'states' becomes empty, so if we stop the search
-    // and call 'go' again without setting a new position states.get() == nullptr.
-    assert(states.get() || setupStates.get());
-
-    if (states.get())
-        setupStates = std::move(states);  // Ownership transfer, states is now empty
+    Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves, this);
 
     // We use Position::set() to set root position across threads. But there are
     // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
     // be deduced from a fen string, so set() clears them and they are set from
-    // setupStates->back() later. The rootState is per thread, earlier states are shared
+    // states.back() later. The rootState is per thread, earlier states are shared
     // since they are read-only.
     for (auto&& th : threads)
     {
@@ -284,9 +333,14 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
               th->worker->bestMoveChanges          = 0;
             th->worker->rootDepth = th->worker->completedDepth = 0;
             th->worker->rootMoves                              = rootMoves;
+            th->worker->stats.clear();
             th->worker->rootPos.set(pos.fen(), pos.is_chess960(), &th->worker->rootState);
-            th->worker->rootState = setupStates->back();
+            th->worker->rootState = states.back();
             th->worker->tbConfig  = tbConfig;
+            th->worker->roundEnd  = roundNodes;
+
+            if (deterministic)
+                th->worker->ttBuffer.allocate();
         });
     }
 
@@ -367,6 +421,8 @@ Thread* ThreadPool::get_best_thread() const {
 // Will be invoked by main thread after it has started searching
 void ThreadPool::start_searching() {
 
+    roundParticipants = threads.size();
+
     for (auto&& th : threads)
         if (th != threads.front())
             th->start_searching();
@@ -382,6 +438,71 @@ void ThreadPool::wait_for_search_finished() const {
             th->wait_for_search_finished();
 }
 
+// Called by a searching thread in deterministic mode once it has used up the nodes
+// of the current round. The last thread to arrive completes the round and wakes
+// up the others.
+void ThreadPool::wait_for_round_end() {
+
+    std::unique_lock<std::mutex> lk(roundMutex);
+    const uint64_t               round = roundCount;
+
+    if (++roundArrived == roundParticipants)
+        complete_round();
+    else
+        roundCv.wait(lk, [&] { return roundCount != round; });
+}
+
+// Called by a thread that has finished its search. Its last writes are committed
+// together with the ones of the current round. The main thread may also request
+// the stop here: doing it later would let the other threads race through an
+// unknown number of further rounds in the meantime.
+void ThreadPool::leave_rounds(bool requestStop) {
+
+    std::unique_lock<std::mutex> lk(roundMutex);
+
+    if (requestStop)
+        roundStopRequested = true;
+
+    if (roundArrived == --roundParticipants)
+        complete_round();
+}
+
+// Stops the search at the end of the current round, when all threads are at a
+// reproducible point of their search, and waits for this to happen.
+void ThreadPool::stop_after_round() {
+
+    std::unique_lock<std::mutex> lk(roundMutex);
+
+    if (!roundParticipants)
+        stop = true;
+
+    roundStopRequested = true;
+    roundCv.wait(lk, [&] { return bool(stop); });
+}
+
+// Must be called with roundMutex locked and all other threads either waiting
+// for the end of the round or done with searching.
+void ThreadPool::complete_round() {
+
+    for (auto&& th : threads)
+        th->worker->ttBuffer.commit(th->worker->tt);
+
+    const Search::Worker& main = *main_thread()->worker;
+
+    if (main.limits.nodes && main.completedDepth >= 1 && nodes_searched() >= main.limits.nodes)
+        stop = abortedSearch = true;
+
+    if (roundStopRequested)
+        stop = true;
+
+    for (auto&& th : threads)
+        th->worker->roundEnd = th->worker->nodes + roundNodes;
+
+    roundArrived = 0;
+    ++roundCount;
+    roundCv.notify_all();
+}
+
 std::vector<size_t> ThreadPool::get_bound_thread_count_by_numa_node() const {
     std::vector<size_t> counts;
 
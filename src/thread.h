@@ -28,6 +28,7 @@
 #include <mutex>
 #include <vector>
 
+#include "memory.h"
 #include "numa.h"
 #include "position.h"
 #include "search.h"
@@ -75,7 +76,8 @@ class Thread {
     Thread(Search::SharedState&,
            std::unique_ptr<Search::ISearchManager>,
            size_t,
-           OptionalThreadToNumaNodeBinder);
+           OptionalThreadToNumaNodeBinder,
+           LargePagePtr<Search::Histories>* sharedHistories);
     virtual ~Thread();
 
     void idle_loop();
@@ -91,8 +93,8 @@ class Thread {
     void   wait_for_search_finished();
     size_t id() const { return idx; }
 
-    std::unique_ptr<Search::Worker> worker;
-    std::function<void()>           jobFunc;
+    LargePagePtr<Search::Worker> worker;
+    std::function<void()>        jobFunc;
 
    private:
     std::mutex                mutex;
@@ -104,6 +106,48 @@ class Thread {
 };
 
 
+// CurrentlySearching is a small lock-free table used by the ABDADA SMP mode.
+// Before searching a child node a thread publishes the child's key here, and
+// removes it when done. Siblings use it to defer moves that another thread is
+// already busy with and search the remaining moves first. The table is only a
+// hint: collisions and races may cost some efficiency, but never correctness.
+class CurrentlySearching {
+   public:
+    // Only nodes with at least this remaining depth are published and checked,
+    // below that the overhead outweighs the savings.
+    static constexpr Depth DeferDepth = 3;
+
+    // The table is allocated only while the ABDADA mode is in use
+    void enable(bool on) {
+        if (on && !table)
+            table = std::make_unique<std::atomic<Key>[]>(Size);
+        else if (!on)
+            table.reset();
+    }
+
+    bool contains(Key key) const {
+        return table[key & (Size - 1)].load(std::memory_order_relaxed) == key;
+    }
+
+    void insert(Key key) { table[key & (Size - 1)].store(key, std::memory_order_relaxed); }
+
+    void remove(Key key) {
+        if (table[key & (Size - 1)].load(std::memory_order_relaxed) == key)
+            table[key & (Size - 1)].store(0, std::memory_order_relaxed);
+    }
+
+    void clear() {
+        for (size_t i = 0; table && i < Size; ++i)
+            table[i].store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr size_t Size = 1 << 16;  // Has to be a power of 2
+
+    std::unique_ptr<std::atomic<Key>[]> table;
+};
+
+
 // ThreadPool struct handles all the threads-related stuff like init, starting,
 // parking and, most importantly, launching a thread. All the access to threads
 // is done through this class.
@@ -127,7 +171,7 @@ class ThreadPool {
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool& operator=(ThreadPool&&)      = delete;
 
-    void   start_thinking(const OptionsMap&, Position&, StateListPtr&, Search::LimitsType);
+    void   start_thinking(const OptionsMap&, Position&, const StateArena&, Search::LimitsType);
     void   run_on_thread(size_t threadId, std::function<void()> f);
     void   wait_on_thread(size_t threadId);
     size_t num_threads() const;
@@ -140,6 +184,9 @@ class ThreadPool {
     Thread*                main_thread() const { return threads.front().get(); }
     uint64_t               nodes_searched() const;
     uint64_t               tb_hits() const;
+    uint64_t               round_nodes_searched(const Search::Worker&) const;
+    size_t                 worker_memory_footprint() const;
+    size_t                 shared_histories_count() const;
     Thread*                get_best_thread() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
@@ -148,6 +195,24 @@ class ThreadPool {
 
     std::atomic_bool stop, abortedSearch, increaseDepth;
 
+    // Sum of the statistics of all the searches since the last clear(). Added to
+    // at the end of each search, so it is read under the lock while searching.
+    Search::SearchStats searchStats;
+    mutable std::mutex  searchStatsMutex;
+
+    // Set by start_thinking() when the ABDADA SMP mode is selected
+    bool               deferMoves = false;
+    CurrentlySearching currentlySearching;
+
+    // Deterministic SMP mode. Threads search in rounds of roundNodes nodes each,
+    // and wait for each other at the end of every round. Stopping the search and
+    // committing the TT writes happen only there, in thread order.
+    bool     deterministic = false;
+    uint64_t roundNodes;
+    void     wait_for_round_end();
+    void     leave_rounds(bool requestStop = false);
+    void     stop_after_round();
+
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
     auto end() noexcept { return threads.end(); }
@@ -156,9 +221,19 @@ class ThreadPool {
     auto empty() const noexcept { return threads.empty(); }
 
    private:
-    StateListPtr                         setupStates;
-    std::vector<std::unique_ptr<Thread>> threads;
-    std::vector<NumaIndex>               boundThreadToNumaNode;
+    void complete_round();
+
+    std::mutex              roundMutex;
+    std::condition_variable roundCv;
+    size_t                  roundParticipants = 0, roundArrived = 0;
+    uint64_t                roundCount        = 0;
+    bool                    roundStopRequested = false;
+
+    // Declared before the threads, so that their workers are joined before
+    // the histories they share are destroyed.
+    std::vector<LargePagePtr<Search::Histories>> sharedHistories;  // One per NUMA node
+    std::vector<std::unique_ptr<Thread>>         threads;
+    std::vector<NumaIndex>                       boundThreadToNumaNode;
 
     uint64_t accumulate(std::atomic<uint64_t> Search::Worker::*member) const {
 
@@ -23,6 +23,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 
 #include "memory.h"
 #include "misc.h"
@@ -61,6 +62,7 @@ struct TTEntry {
 
    private:
     friend class TranspositionTable;
+    friend class TTRoundBuffer;
 
     uint16_t key16;
     uint8_t  depth8;
@@ -244,4 +246,88 @@ TTEntry* TranspositionTable::first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
 }
 
+
+// A round buffer slot holds a private copy of the shared entry a key maps to, as
+// it was when first probed during the round, and the same entry after our writes.
+struct TTRoundBuffer::Slot {
+    Key      key;
+    uint32_t round;
+    TTEntry  entry, original;
+};
+
+// Big enough for the writes of a round, see full()
+static constexpr uint32_t RoundBufferSize = 1 << 16;
+
+TTRoundBuffer::TTRoundBuffer()  = default;
+TTRoundBuffer::~TTRoundBuffer() = default;
+
+void TTRoundBuffer::allocate() {
+
+    // Drop the writes done after the last commit of the previous search, while
+    // the threads were unwinding from the stop: their amount is not reproducible.
+    if (slots)
+    {
+        used.clear();
+        ++round;
+        return;
+    }
+
+    slots = std::make_unique<Slot[]>(RoundBufferSize);
+    used.reserve(RoundBufferSize);
+}
+
+bool TTRoundBuffer::full() const { return used.size() >= RoundBufferSize / 2; }
+
+// Looks up the key in the buffer first, and on a miss copies the shared entry
+// (either the matching one or the one that would be replaced) into a free slot.
+// The returned writer always points to the private copy.
+std::tuple<bool, TTData, TTWriter> TTRoundBuffer::probe(const TranspositionTable& tt,
+                                                        const Key                 key) {
+    // Should never happen, as rounds are ended well before, but in any case
+    // fall back to the shared table rather than looping forever.
+    if (used.size() + 1 >= RoundBufferSize)
+        return tt.probe(key);
+
+    uint32_t idx = uint32_t(key) & (RoundBufferSize - 1);
+
+    while (slots[idx].round == round && slots[idx].key != key)
+        idx = (idx + 1) & (RoundBufferSize - 1);
+
+    Slot& slot = slots[idx];
+
+    if (slot.round != round)
+    {
+        slot.key   = key;
+        slot.round = round;
+        slot.entry = slot.original = *std::get<2>(tt.probe(key)).entry;
+        used.push_back(idx);
+    }
+
+    const TTEntry& tte = slot.entry;
+    return {tte.key16 == uint16_t(key) && tte.depth8, tte.read(), TTWriter(&slot.entry)};
+}
+
+// Saves the entries written during the round into the shared table, in the order
+// they were first accessed, and empties the buffer for the next round.
+void TTRoundBuffer::commit(TranspositionTable& tt) {
+
+    for (uint32_t idx : used)
+    {
+        const Slot&    slot = slots[idx];
+        const TTEntry& tte  = slot.entry;
+
+        if (tte.key16 != uint16_t(slot.key) || !tte.depth8
+            || !std::memcmp(&tte, &slot.original, sizeof(TTEntry)))
+            continue;
+
+        const TTData data = tte.read();
+        std::get<2>(tt.probe(slot.key))
+          .write(slot.key, data.value, data.is_pv, data.bound, data.depth, data.move, data.eval,
+                 tte.genBound8 & GENERATION_MASK);
+    }
+
+    used.clear();
+    ++round;
+}
+
 }  // namespace Stockfish
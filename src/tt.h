@@ -21,7 +21,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <tuple>
+#include <vector>
 
 #include "memory.h"
 #include "types.h"
@@ -61,6 +63,7 @@ struct TTWriter {
 
    private:
     friend class TranspositionTable;
+    friend class TTRoundBuffer;
     TTEntry* entry;
     TTWriter(TTEntry* tte);
 };
@@ -86,6 +89,7 @@ class TranspositionTable {
 
    private:
     friend struct TTEntry;
+    friend class TTRoundBuffer;
 
     size_t   clusterCount;
     Cluster* table = nullptr;
@@ -93,6 +97,31 @@ class TranspositionTable {
     uint8_t generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
 };
 
+
+// TTRoundBuffer is a private, per-thread view of the transposition table used by the
+// deterministic SMP mode. The search runs in rounds, and during a round the shared
+// table is only read: all writes go to this buffer, which also serves the thread's
+// own later probes. At the end of each round the buffers of all threads are committed
+// in thread order, so the contents of the shared table do not depend on thread timing.
+class TTRoundBuffer {
+
+   public:
+    TTRoundBuffer();
+    ~TTRoundBuffer();
+
+    void allocate();  // Allocate on first use or reset, from the owning thread
+    std::tuple<bool, TTData, TTWriter> probe(const TranspositionTable& tt, const Key key);
+    void commit(TranspositionTable& tt);  // Replay buffered writes into the shared table
+    bool full() const;  // True when the round should be ended to make room for new entries
+
+   private:
+    struct Slot;
+
+    std::unique_ptr<Slot[]> slots;
+    std::vector<uint32_t>   used;  // Indices of the slots taken, in order of first access
+    uint32_t                round = 1;
+};
+
 }  // namespace Stockfish
 
 #endif  // #ifndef TT_H_INCLUDED
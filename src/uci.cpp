@@ -22,6 +22,7 @@
 #include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
 #include <optional>
 #include <sstream>
 #include <string_view>
@@ -31,9 +32,11 @@
 #include "benchmark.h"
 #include "engine.h"
 #include "movegen.h"
+#include "posfile.h"
 #include "position.h"
 #include "score.h"
 #include "search.h"
+#include "syzygy/tbprobe.h"
 #include "types.h"
 #include "ucioption.h"
 
@@ -67,7 +70,11 @@ UCIEngine::UCIEngine(int argc, char** argv) :
     engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves(i); });
     engine.set_on_update_full(
       [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
-    engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
+    engine.set_on_bestmove([this](const auto& bm, const auto& p) {
+        if (engine.get_options()["SyzygyStats"])
+            on_tb_stats(Tablebases::stats(8));
+        on_bestmove(bm, p);
+    });
 }
 
 void UCIEngine::loop() {
@@ -105,6 +112,8 @@ void UCIEngine::loop() {
             sync_cout << "info string " << engine.numa_config_information_as_string() << sync_endl;
             sync_cout << "info string " << engine.thread_binding_information_as_string()
                       << sync_endl;
+            sync_cout << "info string " << engine.thread_allocation_information_as_string()
+                      << sync_endl;
 
             sync_cout << "uciok" << sync_endl;
         }
@@ -126,12 +135,78 @@ void UCIEngine::loop() {
             engine.flip();
         else if (token == "bench")
             bench(is);
+        else if (token == "attackbench")
+        {
+            size_t iterations = 100000;
+            is >> iterations;
+            sync_cout << Benchmark::attack_bench(iterations) << sync_endl;
+        }
+        else if (token == "fenbench")
+        {
+            size_t iterations = 10000;
+            is >> iterations;
+            sync_cout << Benchmark::fen_bench(iterations) << sync_endl;
+        }
+        else if (token == "tbwarm")
+        {
+            int pieces = Tablebases::MaxCardinality;
+            is >> pieces;
+            // Run before locking the output, the search may be printing until it stops
+            const std::string result = engine.preload_tablebases(pieces);
+            sync_cout << "info string " << result << sync_endl;
+        }
+        else if (token == "tbcache")
+            sync_cout << "info string " << Tablebases::wdl_cache_stats() << sync_endl;
+        else if (token == "tbstats")
+        {
+            size_t tables = 32;
+            is >> tables;
+            on_tb_stats(Tablebases::stats(tables));
+        }
+        else if (token == "tbdtzbench")
+        {
+            int    pieces    = Tablebases::MaxCardinality;
+            size_t positions = 16;
+            is >> pieces >> positions;
+            // Run before locking the output, the search may be printing until it stops
+            const std::string result = engine.tablebase_dtz_bench(pieces, positions);
+            sync_cout << result << sync_endl;
+        }
+        else if (token == "tbmapbench")
+        {
+            size_t threads = 1;
+            is >> threads;
+            // Run before locking the output, the search may be printing until it
+            // stops, and the reloading of the tables prints too
+            const std::string result = engine.tablebase_map_bench(threads);
+            sync_cout << result << sync_endl;
+        }
+        else if (token == "seebench")
+        {
+            size_t iterations = 10000;
+            is >> iterations;
+            sync_cout << Benchmark::see_bench(iterations) << sync_endl;
+        }
         else if (token == "d")
             sync_cout << engine.visualize() << sync_endl;
         else if (token == "eval")
             engine.trace_eval();
+        else if (token == "searchstats")
+            sync_cout << engine.search_stats() << sync_endl;
         else if (token == "compiler")
             sync_cout << compiler_info() << sync_endl;
+        else if (token == "pack")
+        {
+            std::string   fenFile, packedFile;
+            std::ifstream fens;
+
+            if (is >> fenFile >> packedFile)
+                fens.open(fenFile);
+
+            sync_cout << "info string Packed "
+                      << PositionFile::pack(fens, packedFile, engine.get_options()["UCI_Chess960"])
+                      << " positions into " << packedFile << sync_endl;
+        }
         else if (token == "export_net")
         {
             std::pair<std::optional<std::string>, std::string> files[2];
@@ -191,6 +266,10 @@ Search::LimitsType UCIEngine::parse_limits(std::istream& is) {
             is >> limits.mate;
         else if (token == "perft")
             is >> limits.perft;
+        else if (token == "threads")
+            is >> limits.perftThreads;
+        else if (token == "hash")
+            is >> limits.perftHash;
         else if (token == "infinite")
             limits.infinite = 1;
         else if (token == "ponder")
@@ -285,13 +364,20 @@ void UCIEngine::setoption(std::istringstream& is) {
 }
 
 std::uint64_t UCIEngine::perft(const Search::LimitsType& limits) {
-    auto nodes = engine.perft(engine.fen(), limits.perft, engine.get_options()["UCI_Chess960"]);
-    sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+    TimePoint elapsed = now();
+    auto      nodes   = engine.perft(engine.fen(), limits.perft, engine.get_options()["UCI_Chess960"],
+                                     limits.perftThreads, limits.perftHash);
+    elapsed           = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    sync_cout << "\nNodes searched: " << nodes << "\nNodes/second: " << 1000 * nodes / elapsed
+              << "\n"
+              << sync_endl;
     return nodes;
 }
 
 void UCIEngine::position(std::istringstream& is) {
-    std::string token, fen;
+    std::string token, fen, fname;
+    size_t      idx = 0;
 
     is >> token;
 
@@ -303,9 +389,46 @@ void UCIEngine::position(std::istringstream& is) {
     else if (token == "fen")
         while (is >> token && token != "moves")
             fen += token + " ";
+    else if (token == "packed")
+    {
+        if (!(is >> fname >> idx))
+        {
+            sync_cout << "info string Usage: position packed <file> <index> [moves ...]"
+                      << sync_endl;
+            return;
+        }
+
+        is >> token;  // Consume the "moves" token, if any
+
+        // Keep the file mapped, bulk jobs read many positions from the same file
+        if (fname != positionFile.name())
+            positionFile.open(fname);
+
+        if (idx >= positionFile.size())
+        {
+            sync_cout << "info string Unable to read position " << idx << " from " << fname
+                      << sync_endl;
+            return;
+        }
+
+        if (std::string_view error = Position::validate_packed(positionFile[idx]);
+            !error.empty())
+        {
+            sync_cout << "info string Invalid packed position " << idx << ": " << error
+                      << sync_endl;
+            return;
+        }
+    }
     else
         return;
 
+    if (!fen.empty())
+        if (std::string_view error = Position::validate_fen(fen); !error.empty())
+        {
+            sync_cout << "info string Invalid FEN: " << error << sync_endl;
+            return;
+        }
+
     std::vector<std::string> moves;
 
     while (is >> token)
@@ -313,7 +436,10 @@ void UCIEngine::position(std::istringstream& is) {
         moves.push_back(token);
     }
 
-    engine.set_position(fen, moves);
+    if (fname.empty())
+        engine.set_position(fen, moves);
+    else
+        engine.set_position(positionFile[idx], moves);
 }
 
 namespace {
@@ -476,6 +602,13 @@ void UCIEngine::on_iter(const Engine::InfoIter& info) {
     sync_cout << ss.str() << sync_endl;
 }
 
+void UCIEngine::on_tb_stats(const std::string& stats) {
+    std::istringstream ss(stats);
+
+    for (std::string line; std::getline(ss, line);)
+        sync_cout << "info string " << line << sync_endl;
+}
+
 void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder) {
     sync_cout << "bestmove " << bestmove;
     if (!ponder.empty())
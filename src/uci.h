@@ -26,6 +26,7 @@
 
 #include "engine.h"
 #include "misc.h"
+#include "posfile.h"
 #include "search.h"
 
 namespace Stockfish {
@@ -55,8 +56,9 @@ class UCIEngine {
     auto& engine_options() { return engine.get_options(); }
 
    private:
-    Engine      engine;
-    CommandLine cli;
+    Engine       engine;
+    CommandLine  cli;
+    PositionFile positionFile;  // Last file used by 'position packed'
 
     void          go(std::istringstream& is);
     void          bench(std::istream& args);
@@ -68,6 +70,7 @@ class UCIEngine {
     static void on_update_full(const Engine::InfoFull& info, bool showWDL);
     static void on_iter(const Engine::InfoIter& info);
     static void on_bestmove(std::string_view bestmove, std::string_view ponder);
+    static void on_tb_stats(const std::string& stats);
 };
 
 }  // namespace Stockfish
@@ -123,6 +123,14 @@ cat << EOF > game.exp
  send "go nodes 1000\n"
  expect "bestmove"
 
+ send "position startpos\n"
+ send "go infinite\n"
+ send "position startpos moves e2e4\n"
+ send "stop\n"
+ expect "bestmove"
+ send "isready\n"
+ expect "readyok"
+
  send "ucinewgame\n"
  send "position fen 5rk1/1K4p1/8/8/3B4/8/8/8 b - - 0 1\n"
  send "go depth 10\n"
@@ -213,6 +221,15 @@ cat << EOF > game.exp
  expect "score mate -1 * pv e3e2 f7f5"
  expect "bestmove e3e2"
 
+ send "position fen 8/8/3k4/8/8/8/8/8 w - - 0 1\n"
+ expect "info string Invalid FEN: each side must have exactly one king"
+ send "position fen 4k3/8/8/8/8/8/8/4K3 w KQ - 0 1\n"
+ expect "info string Invalid FEN: castling rights without a rook to castle with"
+ send "position fen 4k3/8/8/8/8/8/4K3/R7 w Q - 0 1\n"
+ expect "info string Invalid FEN: castling rights without the king on its first rank"
+ send "position packed positions.bin moves e2e4\n"
+ expect "info string Usage: position packed <file> <index>"
+
  send "setoption name EvalFile value verify.nnue\n"
  send "position startpos\n"
  send "go depth 5\n"
@@ -270,6 +287,43 @@ cat << EOF > syzygy.exp
  send "go depth 5\n"
  expect -re {score cp -20000|score mate}
  expect "bestmove"
+ send "ucinewgame\n"
+ send "position fen 8/6K1/8/4k3/8/2b5/1p6/8 b - - 0 1\n"
+ send "go depth 5\n"
+ expect -re {score cp 20000|score mate}
+ expect "bestmove"
+ send "tbwarm\n"
+ expect "info string Preloaded 35 tablebases"
+ send "tbcache\n"
+ expect "info string WDL cache"
+ send "setoption name SyzygyStats value true\n"
+ send "ucinewgame\n"
+ send "position fen 8/1P6/2B5/8/4K3/8/6k1/8 w - - 0 1\n"
+ send "go depth 5\n"
+ expect "bestmove"
+ send "tbstats\n"
+ expect "tables probed"
+ send "setoption name SyzygyStats value false\n"
+ send "tbdtzbench 4 4\n"
+ expect -re {Mismatches +: 0}
+ send "setoption name SyzygyIndexFile value syzygy.idx\n"
+ expect "info string Found 35 tablebases"
+ # drop a table from the index, reloading must then miss it
+ set f [open syzygy.idx]
+ set lines [split [read -nonewline \$f] "\n"]
+ close \$f
+ set f [open syzygy.idx w]
+ puts \$f [join [lsearch -all -inline -not -glob \$lines "KBPvK.rtbw *"] "\n"]
+ close \$f
+ send "setoption name SyzygyPath value ../tests/syzygy/\n"
+ expect "info string Found 34 tablebases"
+ send "setoption name SyzygyIndexFile value <empty>\n"
+ expect "info string Found 35 tablebases"
+ send "setoption name SyzygyMemoryLimit value 1\n"
+ send "bench 16 $threads 8 default depth\n"
+ expect "Nodes searched  :"
+ send "tbstats\n"
+ expect "MB limit"
  send "quit\n"
  expect eof
 
@@ -291,6 +345,6 @@ do
 
 done
 
-rm -f tsan.supp bench_tmp.epd
+rm -f tsan.supp bench_tmp.epd syzygy.idx
 
 echo "instrumented testing OK"
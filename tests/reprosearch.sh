@@ -16,11 +16,14 @@ echo "reprosearch testing started"
 cat << EOF > repeat.exp
  set timeout 10
  spawn ./stockfish
- lassign \$argv nodes
+ lassign \$argv nodes threads mode
 
  send "uci\n"
  expect "uciok"
 
+ send "setoption name Threads value \$threads\n"
+ send "setoption name SMPMode value \$mode\n"
+
  send "ucinewgame\n"
  send "position startpos\n"
  send "go nodes \$nodes\n"
@@ -45,15 +48,18 @@ EOF
 
 # to increase the likelihood of finding a non-reproducible case,
 # the allowed number of nodes are varied systematically
-for i in `seq 1 20`
+for setup in "1 LazySMP" "4 Deterministic"
 do
+  for i in `seq 1 20`
+  do
 
-  nodes=$((100*3**i/2**i))
-  echo "reprosearch testing with $nodes nodes"
+    nodes=$((100*3**i/2**i))
+    echo "reprosearch testing with $nodes nodes ($setup)"
 
-  # each line should appear exactly an even number of times
-  expect repeat.exp $nodes 2>&1 | grep -o "nodes [0-9]*" | sort | uniq -c | awk '{if ($1%2!=0) exit(1)}'
+    # each line should appear exactly an even number of times
+    expect repeat.exp $nodes $setup 2>&1 | grep -o "nodes [0-9]*" | sort | uniq -c | awk '{if ($1%2!=0) exit(1)}'
 
+  done
 done
 
 rm repeat.exp